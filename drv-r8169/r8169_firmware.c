@@ -10,6 +10,11 @@
 
 #include <linux/delay.h>
 #include <linux/firmware.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
 
 #include "r8169_firmware.h"
 
@@ -27,6 +32,8 @@ enum rtl_fw_opcode {
 	PHY_WRITE_PREVIOUS	= 0xc,
 	PHY_SKIPN		= 0xd,
 	PHY_DELAY_MS		= 0xe,
+	/* not a firmware opcode, marks the zero action ending the program */
+	PHY_END			= 0xf,
 };
 
 struct fw_info {
@@ -39,11 +46,34 @@ struct fw_info {
 
 #define FW_OPCODE_SIZE sizeof_field(struct rtl_fw_phy_action, code[0])
 
-static bool rtl_fw_format_ok(struct rtl_fw *rtl_fw)
+struct rtl_fw_insn {
+	u8 op;
+	u16 regno;
+	u16 data;
+	/* next index when a jump or skip is taken */
+	u32 target;
+};
+
+struct rtl_fw_blob {
+	struct list_head list;
+	struct kref kref;
+	const struct firmware *fw;
+	const char *fw_name;
+	char version[RTL_VER_SIZE];
+	struct rtl_fw_phy_action phy_action;
+	struct rtl_fw_insn *prog;
+	bool mac_mcu;
+};
+
+/* firmware files are parsed and validated once for all ports */
+static LIST_HEAD(rtl_fw_cache);
+static DEFINE_MUTEX(rtl_fw_cache_lock);
+
+static bool rtl_fw_format_ok(struct rtl_fw_blob *blob)
 {
-	const struct firmware *fw = rtl_fw->fw;
+	const struct firmware *fw = blob->fw;
 	struct fw_info *fw_info = (struct fw_info *)fw->data;
-	struct rtl_fw_phy_action *pa = &rtl_fw->phy_action;
+	struct rtl_fw_phy_action *pa = &blob->phy_action;
 
 	if (fw->size < FW_OPCODE_SIZE)
 		return false;
@@ -68,7 +98,7 @@ static bool rtl_fw_format_ok(struct rtl_fw *rtl_fw)
 		if (size > (fw->size - start) / FW_OPCODE_SIZE)
 			return false;
 
-		strscpy(rtl_fw->version, fw_info->version, RTL_VER_SIZE);
+		strscpy(blob->version, fw_info->version, RTL_VER_SIZE);
 
 		pa->code = (__le32 *)(fw->data + start);
 		pa->size = size;
@@ -76,7 +106,7 @@ static bool rtl_fw_format_ok(struct rtl_fw *rtl_fw)
 		if (fw->size % FW_OPCODE_SIZE)
 			return false;
 
-		strscpy(rtl_fw->version, rtl_fw->fw_name, RTL_VER_SIZE);
+		strscpy(blob->version, blob->fw_name, RTL_VER_SIZE);
 
 		pa->code = (__le32 *)fw->data;
 		pa->size = fw->size / FW_OPCODE_SIZE;
@@ -85,9 +115,9 @@ static bool rtl_fw_format_ok(struct rtl_fw *rtl_fw)
 	return true;
 }
 
-static bool rtl_fw_data_ok(struct rtl_fw *rtl_fw)
+static bool rtl_fw_data_ok(struct rtl_fw_blob *blob, struct device *dev)
 {
-	struct rtl_fw_phy_action *pa = &rtl_fw->phy_action;
+	struct rtl_fw_phy_action *pa = &blob->phy_action;
 	size_t index;
 
 	for (index = 0; index < pa->size; index++) {
@@ -126,50 +156,85 @@ static bool rtl_fw_data_ok(struct rtl_fw *rtl_fw)
 			break;
 
 		default:
-			dev_err(rtl_fw->dev, "Invalid action 0x%08x\n", action);
+			dev_err(dev, "Invalid action 0x%08x\n", action);
 			return false;
 		}
 	}
 
 	return true;
 out:
-	dev_err(rtl_fw->dev, "Out of range of firmware\n");
+	dev_err(dev, "Out of range of firmware\n");
 	return false;
 }
 
-void rtl_fw_write_firmware(struct rtl8169_private *rtl_p, struct rtl_fw *rtl_fw)
+/* Decode the validated actions once, so that applying the firmware on every
+ * open and resume doesn't have to.
+ */
+static bool rtl_fw_decode(struct rtl_fw_blob *blob)
 {
-	struct rtl_fw_phy_action *pa = &rtl_fw->phy_action;
-	rtl_fw_write_t fw_write = rtl_fw->phy_write;
-	rtl_fw_read_t fw_read = rtl_fw->phy_read;
-	int predata = 0, count = 0;
+	struct rtl_fw_phy_action *pa = &blob->phy_action;
 	size_t index;
 
+	blob->prog = kvcalloc(pa->size, sizeof(*blob->prog), GFP_KERNEL);
+	if (!blob->prog)
+		return false;
+
 	for (index = 0; index < pa->size; index++) {
+		struct rtl_fw_insn *insn = &blob->prog[index];
 		u32 action = le32_to_cpu(pa->code[index]);
-		u32 data = action & 0x0000ffff;
-		u32 regno = (action & 0x0fff0000) >> 16;
-		enum rtl_fw_opcode opcode = action >> 28;
 
-		if (!action)
+		insn->op = action ? action >> 28 : PHY_END;
+		insn->regno = (action & 0x0fff0000) >> 16;
+		insn->data = action & 0x0000ffff;
+
+		switch (insn->op) {
+		case PHY_MDIO_CHG:
+			if (insn->data)
+				blob->mac_mcu = true;
+			break;
+		case PHY_BJMPN:
+			insn->target = index - insn->regno;
+			break;
+		case PHY_READCOUNT_EQ_SKIP:
+			insn->target = index + 2;
+			break;
+		case PHY_COMP_EQ_SKIPN:
+		case PHY_COMP_NEQ_SKIPN:
+		case PHY_SKIPN:
+			insn->target = index + 1 + insn->regno;
 			break;
+		}
+	}
+
+	return true;
+}
 
-		switch (opcode) {
+void rtl_fw_write_firmware(struct rtl8169_private *rtl_p, struct rtl_fw *rtl_fw)
+{
+	rtl_fw_write_t fw_write = rtl_fw->phy_write;
+	rtl_fw_read_t fw_read = rtl_fw->phy_read;
+	int predata = 0, count = 0;
+	size_t index = 0;
+
+	while (index < rtl_fw->prog_len) {
+		const struct rtl_fw_insn *insn = &rtl_fw->prog[index++];
+
+		switch (insn->op) {
 		case PHY_READ:
-			predata = fw_read(rtl_p, regno);
+			predata = fw_read(rtl_p, insn->regno);
 			count++;
 			break;
 		case PHY_DATA_OR:
-			predata |= data;
+			predata |= insn->data;
 			break;
 		case PHY_DATA_AND:
-			predata &= data;
+			predata &= insn->data;
 			break;
 		case PHY_BJMPN:
-			index -= (regno + 1);
+			index = insn->target;
 			break;
 		case PHY_MDIO_CHG:
-			if (data) {
+			if (insn->data) {
 				fw_write = rtl_fw->mac_mcu_write;
 				fw_read = rtl_fw->mac_mcu_read;
 			} else {
@@ -182,55 +247,166 @@ void rtl_fw_write_firmware(struct rtl8169_private *rtl_p, struct rtl_fw *rtl_fw)
 			count = 0;
 			break;
 		case PHY_WRITE:
-			fw_write(rtl_p, regno, data);
+			fw_write(rtl_p, insn->regno, insn->data);
 			break;
 		case PHY_READCOUNT_EQ_SKIP:
-			if (count == data)
-				index++;
+			if (count == insn->data)
+				index = insn->target;
 			break;
 		case PHY_COMP_EQ_SKIPN:
-			if (predata == data)
-				index += regno;
+			if (predata == insn->data)
+				index = insn->target;
 			break;
 		case PHY_COMP_NEQ_SKIPN:
-			if (predata != data)
-				index += regno;
+			if (predata != insn->data)
+				index = insn->target;
 			break;
 		case PHY_WRITE_PREVIOUS:
-			fw_write(rtl_p, regno, predata);
+			fw_write(rtl_p, insn->regno, predata);
 			break;
 		case PHY_SKIPN:
-			index += regno;
+			index = insn->target;
 			break;
 		case PHY_DELAY_MS:
-			msleep(data);
+			msleep(insn->data);
 			break;
+		case PHY_END:
+			return;
 		}
 	}
 }
 
+static void rtl_fw_blob_release(struct kref *kref)
+	__releases(&rtl_fw_cache_lock)
+{
+	struct rtl_fw_blob *blob = container_of(kref, struct rtl_fw_blob, kref);
+
+	list_del(&blob->list);
+	mutex_unlock(&rtl_fw_cache_lock);
+
+	release_firmware(blob->fw);
+	kvfree(blob->prog);
+	kfree(blob);
+}
+
 void rtl_fw_release_firmware(struct rtl_fw *rtl_fw)
 {
-	release_firmware(rtl_fw->fw);
+	kref_put_mutex(&rtl_fw->blob->kref, rtl_fw_blob_release,
+		       &rtl_fw_cache_lock);
+	rtl_fw->blob = NULL;
+}
+
+/* called with rtl_fw_cache_lock held */
+static struct rtl_fw_blob *rtl_fw_cache_find(const char *fw_name)
+{
+	struct rtl_fw_blob *blob;
+
+	list_for_each_entry(blob, &rtl_fw_cache, list) {
+		if (!strcmp(blob->fw_name, fw_name)) {
+			kref_get(&blob->kref);
+			return blob;
+		}
+	}
+
+	return NULL;
 }
 
-int rtl_fw_request_firmware(struct rtl_fw *rtl_fw)
+/* called with rtl_fw_cache_lock held, consumes fw */
+static struct rtl_fw_blob *rtl_fw_cache_add(const char *fw_name,
+					    const struct firmware *fw,
+					    struct device *dev, int *rc)
 {
+	struct rtl_fw_blob *blob;
+
+	blob = kzalloc(sizeof(*blob), GFP_KERNEL);
+	if (!blob) {
+		*rc = -ENOMEM;
+		goto err_release;
+	}
+
+	blob->fw_name = fw_name;
+	blob->fw = fw;
+
+	if (!rtl_fw_format_ok(blob) || !rtl_fw_data_ok(blob, dev)) {
+		*rc = -EINVAL;
+		goto err_free;
+	}
+
+	if (!rtl_fw_decode(blob)) {
+		*rc = -ENOMEM;
+		goto err_free;
+	}
+
+	kref_init(&blob->kref);
+	list_add(&blob->list, &rtl_fw_cache);
+
+	return blob;
+
+err_free:
+	kfree(blob);
+err_release:
+	release_firmware(fw);
+	return NULL;
+}
+
+static void rtl_fw_done(struct rtl_fw *rtl_fw, struct rtl_fw_blob *blob, int rc)
+{
+	if (blob) {
+		rtl_fw->blob = blob;
+		rtl_fw->prog = blob->prog;
+		rtl_fw->prog_len = blob->phy_action.size;
+		rtl_fw->mac_mcu = blob->mac_mcu;
+		strscpy(rtl_fw->version, blob->version, RTL_VER_SIZE);
+		rc = 0;
+	} else {
+		dev_err(rtl_fw->dev, "Unable to load firmware %s (%d)\n",
+			rtl_fw->fw_name, rc);
+	}
+
+	rtl_fw->done(rtl_fw->context, rtl_fw, rc);
+}
+
+static void rtl_fw_loaded(const struct firmware *fw, void *context)
+{
+	struct rtl_fw *rtl_fw = context;
+	struct rtl_fw_blob *blob;
+	int rc = -ENOENT;
+
+	mutex_lock(&rtl_fw_cache_lock);
+	/* another port may have loaded the same file in the meantime */
+	blob = rtl_fw_cache_find(rtl_fw->fw_name);
+	if (blob)
+		release_firmware(fw);
+	else if (fw)
+		blob = rtl_fw_cache_add(rtl_fw->fw_name, fw, rtl_fw->dev, &rc);
+	mutex_unlock(&rtl_fw_cache_lock);
+
+	rtl_fw_done(rtl_fw, blob, rc);
+}
+
+/* Load and decode the firmware from a work item, so that probing several
+ * ports doesn't serialize on the filesystem. rtl_fw->done() is called
+ * exactly once, possibly before this function returns.
+ */
+void rtl_fw_request_firmware_nowait(struct rtl_fw *rtl_fw)
+{
+	struct rtl_fw_blob *blob;
 	int rc;
 
-	rc = request_firmware(&rtl_fw->fw, rtl_fw->fw_name, rtl_fw->dev);
-	if (rc < 0)
-		goto out;
+	mutex_lock(&rtl_fw_cache_lock);
+	blob = rtl_fw_cache_find(rtl_fw->fw_name);
+	mutex_unlock(&rtl_fw_cache_lock);
 
-	if (!rtl_fw_format_ok(rtl_fw) || !rtl_fw_data_ok(rtl_fw)) {
-		release_firmware(rtl_fw->fw);
-		rc = -EINVAL;
-		goto out;
+	if (blob) {
+		dev_dbg(rtl_fw->dev, "using cached firmware %s\n",
+			rtl_fw->fw_name);
+		rtl_fw_done(rtl_fw, blob, 0);
+		return;
 	}
 
-	return 0;
-out:
-	dev_err(rtl_fw->dev, "Unable to load firmware %s (%d)\n",
-		rtl_fw->fw_name, rc);
-	return rc;
+	rc = request_firmware_nowait(THIS_MODULE, FW_ACTION_UEVENT,
+				     rtl_fw->fw_name, rtl_fw->dev, GFP_KERNEL,
+				     rtl_fw, rtl_fw_loaded);
+	if (rc)
+		rtl_fw_done(rtl_fw, NULL, rc);
 }
@@ -14,26 +14,41 @@
 struct rtl8169_private;
 typedef void (*rtl_fw_write_t)(struct rtl8169_private *rtl_p, int reg, int val);
 typedef int (*rtl_fw_read_t)(struct rtl8169_private *rtl_p, int reg);
+struct rtl_fw;
+typedef void (*rtl_fw_done_t)(void *context, struct rtl_fw *rtl_fw, int rc);
 
 #define RTL_VER_SIZE		32
 
+struct rtl_fw_phy_action {
+	__le32 *code;
+	size_t size;
+};
+
+/* validated firmware, shared by all devices using the same file */
+struct rtl_fw_blob;
+/* firmware action decoded at load time */
+struct rtl_fw_insn;
+
 struct rtl_fw {
 	rtl_fw_write_t phy_write;
 	rtl_fw_read_t phy_read;
 	rtl_fw_write_t mac_mcu_write;
 	rtl_fw_read_t mac_mcu_read;
-	const struct firmware *fw;
+	struct rtl_fw_blob *blob;
 	const char *fw_name;
 	struct device *dev;
+	/* completion callback of rtl_fw_request_firmware_nowait() */
+	rtl_fw_done_t done;
+	void *context;
 
 	char version[RTL_VER_SIZE];
 
-	struct rtl_fw_phy_action {
-		__le32 *code;
-		size_t size;
-	} phy_action;
+	const struct rtl_fw_insn *prog;
+	size_t prog_len;
+	/* firmware patches the MAC MCU too, not only the PHY */
+	bool mac_mcu;
 };
 
-int rtl_fw_request_firmware(struct rtl_fw *rtl_fw);
+void rtl_fw_request_firmware_nowait(struct rtl_fw *rtl_fw);
 void rtl_fw_release_firmware(struct rtl_fw *rtl_fw);
 void rtl_fw_write_firmware(struct rtl8169_private *rtl_p, struct rtl_fw *rtl_fw);
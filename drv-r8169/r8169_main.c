@@ -23,18 +23,28 @@
 #include <linux/ip.h>
 #include <linux/tcp.h>
 #include <linux/interrupt.h>
+#include <linux/irq.h>
 #include <linux/dma-mapping.h>
 #include <linux/pm_runtime.h>
 #include <linux/bitfield.h>
 #include <linux/prefetch.h>
 #include <linux/ipv6.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
+#include <linux/hash.h>
+#include <linux/completion.h>
 #include <asm/unaligned.h>
 #include <net/ip6_checksum.h>
 #include <net/netdev_queues.h>
+#include <net/devlink.h>
 
 #include "r8169.h"
 #include "r8169_firmware.h"
 
+#define CREATE_TRACE_POINTS
+#include "r8169_trace.h"
+
 #define FIRMWARE_8168D_1	"rtl_nic/rtl8168d-1.fw"
 #define FIRMWARE_8168D_2	"rtl_nic/rtl8168d-2.fw"
 #define FIRMWARE_8168E_1	"rtl_nic/rtl8168e-1.fw"
@@ -69,6 +79,33 @@
 #define NUM_RX_DESC	256	/* Number of Rx descriptor registers */
 #define R8169_TX_RING_BYTES	(NUM_TX_DESC * sizeof(struct TxDesc))
 #define R8169_RX_RING_BYTES	(NUM_RX_DESC * sizeof(struct RxDesc))
+#define R8169_POOL_PAGES	(NUM_RX_DESC << get_order(R8169_RX_BUF_SIZE))
+
+#define RTL_PRIV_FLAG_RETAIN_RINGS	BIT(0)
+#define RTL_PRIV_FLAG_EEE_ADAPTIVE	BIT(1)
+
+enum rtl_profile {
+	RTL_PROFILE_DEFAULT,
+	RTL_PROFILE_LATENCY,
+	RTL_PROFILE_THROUGHPUT,
+	RTL_PROFILE_POWER,
+	RTL_PROFILE_MAX
+};
+
+enum rtl_probe_phase {
+	RTL_PROBE_ENABLE,
+	RTL_PROBE_DETECT,
+	RTL_PROBE_HW_INIT,
+	RTL_PROBE_SETUP,
+	RTL_PROBE_MDIO,
+	RTL_PROBE_REGISTER,
+	RTL_PROBE_MAX
+};
+
+/* Tx occupancy in steps of 16 descriptors, Rx work per poll in powers of 2 */
+#define RTL_TX_OCC_SHIFT	4
+#define RTL_TX_OCC_BUCKETS	(NUM_TX_DESC >> RTL_TX_OCC_SHIFT)
+#define RTL_RX_OCC_BUCKETS	9
 #define R8169_TX_STOP_THRS	(MAX_SKB_FRAGS + 1)
 #define R8169_TX_START_THRS	(2 * R8169_TX_STOP_THRS)
 
@@ -76,6 +113,48 @@
 
 #define RTL_CFG_NO_GBIT	1
 
+/* register spaces and phases recorded by the R8169_REGTRACE build */
+enum rtl_regtrace_space {
+	RTL_TRACE_MMIO8,
+	RTL_TRACE_MMIO16,
+	RTL_TRACE_MMIO32,
+	RTL_TRACE_ERI,
+	RTL_TRACE_MAC_OCP,
+	RTL_TRACE_PHY,
+	RTL_TRACE_EPHY,
+};
+
+enum rtl_regtrace_phase {
+	RTL_TRACE_OFF,
+	RTL_TRACE_HW_START,
+	RTL_TRACE_PHY_CONFIG,
+};
+
+#ifdef R8169_REGTRACE
+struct rtl8169_private;
+static void rtl_regtrace_mmio(struct rtl8169_private *rtl_p, u8 space, u8 op,
+			      u32 reg, u32 val);
+
+#define __RTL_W(rtl_p, space, reg, val, type, wr)			\
+	do {								\
+		type __val = (val);					\
+		rtl_regtrace_mmio(rtl_p, space, 'W', reg, __val);	\
+		wr(__val, rtl_p->mmio_addr + (reg));			\
+	} while (0)
+#define __RTL_R(rtl_p, space, reg, type, rd)				\
+	({								\
+		type __val = rd(rtl_p->mmio_addr + (reg));		\
+		rtl_regtrace_mmio(rtl_p, space, 'R', reg, __val);	\
+		__val;							\
+	})
+
+#define RTL_W8(rtl_p, reg, val8)	__RTL_W(rtl_p, RTL_TRACE_MMIO8, reg, val8, u8, writeb)
+#define RTL_W16(rtl_p, reg, val16)	__RTL_W(rtl_p, RTL_TRACE_MMIO16, reg, val16, u16, writew)
+#define RTL_W32(rtl_p, reg, val32)	__RTL_W(rtl_p, RTL_TRACE_MMIO32, reg, val32, u32, writel)
+#define RTL_R8(rtl_p, reg)		__RTL_R(rtl_p, RTL_TRACE_MMIO8, reg, u8, readb)
+#define RTL_R16(rtl_p, reg)		__RTL_R(rtl_p, RTL_TRACE_MMIO16, reg, u16, readw)
+#define RTL_R32(rtl_p, reg)		__RTL_R(rtl_p, RTL_TRACE_MMIO32, reg, u32, readl)
+#else
 /* write/read MMIO register */
 #define RTL_W8(rtl_p, reg, val8)	writeb((val8), rtl_p->mmio_addr + (reg))
 #define RTL_W16(rtl_p, reg, val16)	writew((val16), rtl_p->mmio_addr + (reg))
@@ -83,6 +162,7 @@
 #define RTL_R8(rtl_p, reg)		readb(rtl_p->mmio_addr + (reg))
 #define RTL_R16(rtl_p, reg)		readw(rtl_p->mmio_addr + (reg))
 #define RTL_R32(rtl_p, reg)		readl(rtl_p->mmio_addr + (reg))
+#endif
 
 #define JUMBO_4K	(4 * SZ_1K - VLAN_ETH_HLEN - ETH_FCS_LEN)
 #define JUMBO_6K	(6 * SZ_1K - VLAN_ETH_HLEN - ETH_FCS_LEN)
@@ -580,9 +660,81 @@ enum rtl_flag {
 	RTL_FLAG_TASK_ENABLED = 0,
 	RTL_FLAG_TASK_RESET_PENDING,
 	RTL_FLAG_TASK_TX_TIMEOUT,
+	RTL_FLAG_TASK_COALESCE,
 	RTL_FLAG_MAX
 };
 
+enum rtl_sw_stat {
+	RTL_SW_DOORBELL,
+	RTL_SW_DOORBELL_SUPPRESSED,
+	RTL_SW_QUEUE_STOP,
+	RTL_SW_QUEUE_WAKE,
+	RTL_SW_TX_RING_FULL,
+	RTL_SW_TX_MAP_ERR,
+	RTL_SW_RX_ALLOC_ERR,
+	RTL_SW_RX_FRAG_DROP,
+	RTL_SW_NAPI_POLL,
+	RTL_SW_NAPI_BUDGET_EXHAUSTED,
+	RTL_SW_IRQ_NONE,
+	RTL_SW_MMIO_READ,
+	RTL_SW_MMIO_WRITE,
+	RTL_SW_MMIO_WRITE_ELIDED,
+	RTL_SW_STATS_NUM
+};
+
+#define RTL_RMON_BUCKETS	8
+
+/* driver-side event counters, per cpu so they can be bumped from any context */
+struct rtl_sw_stats {
+	unsigned long cnt[RTL_SW_STATS_NUM];
+	unsigned long rx_hist[RTL_RMON_BUCKETS];
+	unsigned long tx_hist[RTL_RMON_BUCKETS];
+};
+
+#define rtl_sw_stat_inc(rtl_p, stat)	this_cpu_inc((rtl_p)->sw_stats->cnt[stat])
+
+#define RTL_PHY_SHADOW_BITS	6
+#define RTL_PHY_SHADOW_VALID	BIT(31)
+
+/*
+ * Write-through shadow of PHY registers. The current page is tracked on
+ * chips with a real page register, so redundant page selects are skipped.
+ * Values written to vendor registers (0x10 and up) are served back to reads
+ * while the PHY is being configured; any write invalidates the other cached
+ * registers of the same page, as many of them are address/data pairs.
+ */
+struct rtl_phy_shadow {
+	u32 key[1 << RTL_PHY_SHADOW_BITS];
+	u16 val[1 << RTL_PHY_SHADOW_BITS];
+	u16 page;
+	bool page_valid;
+	bool active;
+	bool verify;
+	u32 hits;
+	u32 page_elided;
+	u32 mismatches;
+};
+
+#define RTL_REGTRACE_ENTRIES	16384
+
+struct rtl_regtrace_entry {
+	u8 phase;
+	u8 space;
+	u8 op;		/* 'R', 'W', or 'B' at the start of a phase */
+	u8 pad;
+	u16 aux;	/* PHY page or ERI byte enables */
+	u16 pad2;
+	u32 addr;
+	u32 val;
+};
+
+struct rtl_regtrace {
+	raw_spinlock_t lock;
+	struct rtl_regtrace_entry *buf;
+	u32 head;	/* entries recorded since the last clear */
+	u8 phase;
+};
+
 enum rtl_dash_type {
 	RTL_DASH_NONE,
 	RTL_DASH_DP,
@@ -608,6 +760,8 @@ struct rtl8169_private {
 	struct ring_info tx_skb[NUM_TX_DESC];	/* Tx data buffers */
 	u16 cp_cmd;
 	u32 irq_mask;
+	/* IntrMask as last written, ~0 if unknown */
+	u32 irq_mask_hw;
 	int irq;
 	struct clk *clk;
 
@@ -632,12 +786,145 @@ struct rtl8169_private {
 
 	const char *fw_name;
 	struct rtl_fw *rtl_fw;
+	struct completion fw_loaded;
 
 	u32 ocp_base;
+	struct rtl_phy_shadow phy_shadow;
+	/* RTL_PHY_SIG_PARAM as left by the last PHY config */
+	u16 phy_sig;
+	bool phy_sig_valid;
+
+	unsigned long tx_recover_jiffies;
+	bool tx_recovered;
+	s64 tx_recover_us;
+	s64 reset_us;
+	/* MTU changes done without a reset */
+	s64 reconfig_us;
+	u32 reconfigs;
+
+	/* PCI error recovery */
+	struct {
+		ktime_t start;
+		s64 recover_us;
+		u32 errors;
+		u32 recoveries;
+		bool quiesced;
+	} aer;
+
+	u32 priv_flags;
+	struct rtl_sw_stats __percpu *sw_stats;
+
+	/* rings and Rx buffers kept while the interface is down */
+	struct {
+		struct mutex lock;
+		struct TxDesc *tx_desc;
+		struct RxDesc *rx_desc;
+		dma_addr_t tx_phys;
+		dma_addr_t rx_phys;
+		u32 reused;
+	} pool;
+	struct shrinker pool_shrinker;
+
+	s64 probe_us[RTL_PROBE_MAX];
+	s64 probe_total_us;
+	s64 open_us;
+	s64 resume_us;
+	s64 hw_start_us;
+	s64 phy_config_us;
+	u32 phy_config_skipped;
+	s64 fw_apply_us;
+	s64 fw_wait_us;
+	u32 fw_applied;
+	/* register accesses made by the last rtl_hw_start() */
+	struct {
+		u32 ops;
+		u32 reads;
+		u32 writes;
+		u32 merged;
+		u32 reads_elided;
+	} script;
+	struct dentry *debugfs_dir;
+	struct devlink *devlink;
+
+	/* packet rate sampled by rtl_load_work() for the policies below */
+	struct {
+		struct delayed_work work;
+		u32 pps;
+		/* packets handled by rtl8169_poll() */
+		u32 pkts;
+		u32 last_pkts;
+	} load;
+	/* load-aware ASPM/ClkReq policy */
+	struct {
+		bool dynamic;
+		/* kept off regardless of the load */
+		bool off;
+		bool busy;
+		u32 high_pps;
+		u32 low_pps;
+		u32 quiet;
+		u32 to_busy;
+		u32 to_idle;
+	} aspm;
+	/* traffic-adaptive EEE, LPI is off while busy */
+	struct {
+		bool tx_lpi;
+		bool busy;
+		u32 quiet;
+		u32 to_busy;
+		u32 to_idle;
+	} eee;
+	enum rtl_profile profile;
+	/* last coalescing set, reapplied once the link speed is known */
+	struct ethtool_coalesce coal;
+	bool coal_set;
+
+	/* FIFO partitioning and pause thresholds, user values of 0 keep the
+	 * chip defaults set by rtl_fifo_init_defaults() at probe
+	 */
+	struct {
+		u16 rx_user;
+		u16 tx_user;
+		u8 pause_low_user;
+		u8 pause_high_user;
+		u16 rx_def;
+		u16 tx_def;
+		u8 pause_low_def;
+		u8 pause_high_def;
+	} fifo;
+
+	/* runtime PM with a chip that keeps its context in D3hot */
+	struct {
+		bool no_soft_reset;
+		/* don't speed the PHY down, so resume doesn't renegotiate */
+		bool keep_link;
+		bool snap_valid;
+		u32 tx_config;
+		u16 cp_cmd;
+		u16 intr_mitigate;
+		u16 rx_max_size;
+		u8 config2;
+		u8 config5;
+		ktime_t resume_start;
+		bool wait_first_pkt;
+		s64 first_pkt_us;
+		u32 resumes;
+		u32 fast_resumes;
+	} rpm;
+
+	/* sampled in rtl8169_poll() */
+	u64 tx_occ_hist[RTL_TX_OCC_BUCKETS];
+	u64 rx_occ_hist[RTL_RX_OCC_BUCKETS];
+
+#ifdef R8169_REGTRACE
+	struct rtl_regtrace regtrace;
+#endif
 };
 
 typedef void (*rtl_generic_fct)(struct rtl8169_private *rtl_p);
 
+static struct dentry *rtl_debugfs_root;
+
 MODULE_AUTHOR("Realtek and the Linux r8169 crew <netdev@vger.kernel.org>");
 MODULE_DESCRIPTION("RealTek RTL-8169 Gigabit Ethernet driver");
 MODULE_SOFTDEP("pre: realtek");
@@ -668,6 +955,74 @@ static inline struct device *tp_to_dev(struct rtl8169_private *rtl_p)
 	return &rtl_p->pcidev->dev;
 }
 
+#ifdef R8169_REGTRACE
+static void rtl_regtrace(struct rtl8169_private *rtl_p, u8 space, u8 op,
+			 u32 addr, u32 val, u16 aux)
+{
+	struct rtl_regtrace *rt = &rtl_p->regtrace;
+	struct rtl_regtrace_entry *e;
+	unsigned long flags;
+
+	if (!rt->phase)
+		return;
+
+	raw_spin_lock_irqsave(&rt->lock, flags);
+	e = &rt->buf[rt->head++ % RTL_REGTRACE_ENTRIES];
+	e->phase = rt->phase;
+	e->space = space;
+	e->op = op;
+	e->aux = aux;
+	e->addr = addr;
+	e->val = val;
+	raw_spin_unlock_irqrestore(&rt->lock, flags);
+}
+
+static void rtl_regtrace_mmio(struct rtl8169_private *rtl_p, u8 space, u8 op,
+			      u32 reg, u32 val)
+{
+	/* indirect access windows are recorded by their accessors */
+	switch (reg) {
+	case PHYAR:
+	case CSIDR:
+	case CSIAR:
+	case ERIDR:
+	case ERIAR:
+	case EPHYAR:
+	case OCPDR:
+	case OCPAR:
+	case GPHY_OCP:
+	case EFUSEAR:
+		return;
+	}
+
+	rtl_regtrace(rtl_p, space, op, reg, val, 0);
+}
+
+static void rtl_regtrace_begin(struct rtl8169_private *rtl_p, u8 phase)
+{
+	rtl_p->regtrace.phase = phase;
+	rtl_regtrace(rtl_p, 0, 'B', 0, 0, 0);
+}
+
+static void rtl_regtrace_end(struct rtl8169_private *rtl_p)
+{
+	rtl_p->regtrace.phase = RTL_TRACE_OFF;
+}
+#else
+static inline void rtl_regtrace(struct rtl8169_private *rtl_p, u8 space,
+				u8 op, u32 addr, u32 val, u16 aux)
+{
+}
+
+static inline void rtl_regtrace_begin(struct rtl8169_private *rtl_p, u8 phase)
+{
+}
+
+static inline void rtl_regtrace_end(struct rtl8169_private *rtl_p)
+{
+}
+#endif
+
 static void rtl_lock_config_regs(struct rtl8169_private *rtl_p)
 {
 	unsigned long flags;
@@ -743,22 +1098,136 @@ static void rtl_read_mac_from_reg(struct rtl8169_private *rtl_p, u8 *mac, int re
 		mac[i] = RTL_R8(rtl_p, reg + i);
 }
 
+/* log2 buckets: 0, 1, 2-3, 4-7, ... */
+#define RTL_COND_HIST_BUCKETS	16
+
+/* driver-wide wait statistics, one per condition */
+struct rtl_cond_stats {
+	struct list_head list;
+	const char *name;
+	atomic_long_t iter_hist[RTL_COND_HIST_BUCKETS];
+	atomic_long_t usec_hist[RTL_COND_HIST_BUCKETS];
+	atomic_long_t timeouts;
+	atomic_long_t max_usecs;
+	atomic_long_t total_usecs;
+	atomic_long_t avg_nsecs;	/* EWMA of spin phase outcomes */
+	atomic_long_t spin_hits;
+	atomic_long_t spin_misses;
+	atomic_t waits;
+};
+
 struct rtl_cond {
 	bool (*check)(struct rtl8169_private *);
 	const char *msg;
+	struct rtl_cond_stats *stats;
 };
 
+static LIST_HEAD(rtl_cond_list);
+static DEFINE_SPINLOCK(rtl_cond_list_lock);
+
+/*
+ * Most handshakes complete within a few microseconds, far below the sleep
+ * interval passed to rtl_loop_wait(). Busy-poll for up to twice the average
+ * completion time of the condition before sleeping. Only the spin phase
+ * feeds the average, a miss counts as twice the limit, so conditions that
+ * keep taking longer go straight to sleeping. Every RTL_COND_REPROBE-th wait
+ * of such a condition spins for the full limit again to notice when it got
+ * faster. Writing 0 to <debugfs>/<module>/cond_spin_max_ns disables spinning.
+ */
+static u32 rtl_cond_spin_max_ns = 20 * NSEC_PER_USEC;
+#define RTL_COND_SPIN_MIN_NS	(2 * NSEC_PER_USEC)
+#define RTL_COND_REPROBE	64
+
+static u64 rtl_cond_spin_ns(struct rtl_cond_stats *st)
+{
+	u64 max_ns = READ_ONCE(rtl_cond_spin_max_ns);
+	u64 avg_ns = atomic_long_read(&st->avg_nsecs);
+
+	if (avg_ns > max_ns)
+		return atomic_inc_return(&st->waits) % RTL_COND_REPROBE ? 0 : max_ns;
+
+	return clamp_t(u64, 2 * avg_ns, RTL_COND_SPIN_MIN_NS, max_ns);
+}
+
+static void rtl_cond_spin_account(struct rtl_cond_stats *st, bool hit,
+				  s64 nsecs)
+{
+	long avg = atomic_long_read(&st->avg_nsecs);
+
+	if (hit) {
+		atomic_long_inc(&st->spin_hits);
+	} else {
+		atomic_long_inc(&st->spin_misses);
+		nsecs = 2 * (s64)READ_ONCE(rtl_cond_spin_max_ns);
+	}
+
+	atomic_long_set(&st->avg_nsecs,
+			avg ? avg - avg / 8 + (long)nsecs / 8 : (long)nsecs);
+}
+
+static unsigned int rtl_cond_bucket(unsigned long val)
+{
+	return min_t(unsigned int, fls_long(val), RTL_COND_HIST_BUCKETS - 1);
+}
+
+static void rtl_cond_account(const struct rtl_cond *c, int iters, ktime_t start,
+			     bool timeout)
+{
+	struct rtl_cond_stats *st = c->stats;
+	s64 nsecs = ktime_to_ns(ktime_sub(ktime_get(), start));
+	unsigned long usecs = div_u64(nsecs, NSEC_PER_USEC);
+
+	/* conditions show up in debugfs once they have been waited on */
+	if (list_empty_careful(&st->list)) {
+		spin_lock(&rtl_cond_list_lock);
+		if (list_empty(&st->list))
+			list_add_tail(&st->list, &rtl_cond_list);
+		spin_unlock(&rtl_cond_list_lock);
+	}
+
+	atomic_long_inc(&st->iter_hist[rtl_cond_bucket(iters)]);
+	atomic_long_inc(&st->usec_hist[rtl_cond_bucket(usecs)]);
+	if (timeout)
+		atomic_long_inc(&st->timeouts);
+	if (usecs > atomic_long_read(&st->max_usecs))
+		atomic_long_set(&st->max_usecs, usecs);
+	atomic_long_add(usecs, &st->total_usecs);
+}
+
 static bool rtl_loop_wait(struct rtl8169_private *rtl_p, const struct rtl_cond *c,
 			  unsigned long usecs, int n, bool high)
 {
+	ktime_t start = ktime_get();
+	u64 spin_ns = rtl_cond_spin_ns(c->stats);
 	int i;
 
+	/* spin phase, the full sleeping timeout below is still granted */
+	if (spin_ns) {
+		ktime_t spin_end = ktime_add_ns(start, spin_ns);
+
+		do {
+			if (c->check(rtl_p) == high) {
+				rtl_cond_spin_account(c->stats, true,
+						      ktime_to_ns(ktime_sub(ktime_get(), start)));
+				rtl_cond_account(c, 0, start, false);
+				return true;
+			}
+			udelay(1);
+		} while (ktime_before(ktime_get(), spin_end));
+
+		rtl_cond_spin_account(c->stats, false, 0);
+	}
+
 	for (i = 0; i < n; i++) {
-		if (c->check(rtl_p) == high)
+		if (c->check(rtl_p) == high) {
+			rtl_cond_account(c, i, start, false);
 			return true;
+		}
 		fsleep(usecs);
 	}
 
+	rtl_cond_account(c, n, start, true);
+
 	if (net_ratelimit())
 		netdev_err(rtl_p->netdev, "%s == %d (loop: %d, delay: %lu).\n",
 			   c->msg, !high, n, usecs);
@@ -782,9 +1251,15 @@ static bool rtl_loop_wait_low(struct rtl8169_private *rtl_p,
 #define DECLARE_RTL_COND(name)				\
 static bool name ## _check(struct rtl8169_private *);	\
 							\
+static struct rtl_cond_stats name ## _stats = {		\
+	.list	= LIST_HEAD_INIT(name ## _stats.list),	\
+	.name	= #name,				\
+};							\
+							\
 static const struct rtl_cond name = {			\
 	.check	= name ## _check,			\
-	.msg	= #name					\
+	.msg	= #name,				\
+	.stats	= &name ## _stats,			\
 };							\
 							\
 static bool name ## _check(struct rtl8169_private *rtl_p)
@@ -811,6 +1286,8 @@ static void _rtl_eri_write(struct rtl8169_private *rtl_p, int addr, u32 mask,
 	if (WARN(addr & 3 || !mask, "addr: 0x%x, mask: 0x%08x\n", addr, mask))
 		return;
 
+	rtl_regtrace(rtl_p, RTL_TRACE_ERI, 'W', addr, val, mask >> 12);
+
 	RTL_W32(rtl_p, ERIDR, val);
 	r8168fp_adjust_ocp_cmd(rtl_p, &cmd, type);
 	RTL_W32(rtl_p, ERIAR, cmd);
@@ -827,12 +1304,16 @@ static void rtl_eri_write(struct rtl8169_private *rtl_p, int addr, u32 mask,
 static u32 _rtl_eri_read(struct rtl8169_private *rtl_p, int addr, int type)
 {
 	u32 cmd = ERIAR_READ_CMD | type | ERIAR_MASK_1111 | addr;
+	u32 val;
 
 	r8168fp_adjust_ocp_cmd(rtl_p, &cmd, type);
 	RTL_W32(rtl_p, ERIAR, cmd);
 
-	return rtl_loop_wait_high(rtl_p, &rtl_eriar_cond, 100, 100) ?
+	val = rtl_loop_wait_high(rtl_p, &rtl_eriar_cond, 100, 100) ?
 		RTL_R32(rtl_p, ERIDR) : ~0;
+	rtl_regtrace(rtl_p, RTL_TRACE_ERI, 'R', addr, val, ERIAR_MASK_1111 >> 12);
+
+	return val;
 }
 
 static u32 rtl_eri_read(struct rtl8169_private *rtl_p, int addr)
@@ -893,6 +1374,7 @@ static void __r8168_mac_ocp_write(struct rtl8169_private *rtl_p, u32 reg, u32 da
 	if (rtl_ocp_reg_failure(reg))
 		return;
 
+	rtl_regtrace(rtl_p, RTL_TRACE_MAC_OCP, 'W', reg, data, 0);
 	RTL_W32(rtl_p, OCPDR, OCPAR_FLAG | (reg << 15) | data);
 }
 
@@ -907,12 +1389,16 @@ static void r8168_mac_ocp_write(struct rtl8169_private *rtl_p, u32 reg, u32 data
 
 static u16 __r8168_mac_ocp_read(struct rtl8169_private *rtl_p, u32 reg)
 {
+	u16 val;
+
 	if (rtl_ocp_reg_failure(reg))
 		return 0;
 
 	RTL_W32(rtl_p, OCPDR, reg << 15);
+	val = RTL_R32(rtl_p, OCPDR);
+	rtl_regtrace(rtl_p, RTL_TRACE_MAC_OCP, 'R', reg, val, 0);
 
-	return RTL_R32(rtl_p, OCPDR);
+	return val;
 }
 
 static u16 r8168_mac_ocp_read(struct rtl8169_private *rtl_p, u32 reg)
@@ -1076,8 +1562,23 @@ static int r8168dp_2_mdio_read(struct rtl8169_private *rtl_p, int reg)
 	return value;
 }
 
-static void rtl_writephy(struct rtl8169_private *rtl_p, int location, int val)
+/* page of a PHY access for the register trace, 0xffff if unknown */
+static u16 rtl_regtrace_phy_page(struct rtl8169_private *rtl_p)
+{
+	if (rtl_p->mac_version >= RTL_GIGA_MAC_VER_40)
+		return rtl_p->ocp_base == OCP_STD_PHY_BASE ? 0 :
+		       rtl_p->ocp_base >> 4;
+
+	return rtl_p->phy_shadow.page_valid ? rtl_p->phy_shadow.page : 0xffff;
+}
+
+static void __rtl_writephy(struct rtl8169_private *rtl_p, int location, int val)
 {
+	/* page selection on RTL8168g and later is a software-only access */
+	if (location != 0x1f || rtl_p->mac_version < RTL_GIGA_MAC_VER_40)
+		rtl_regtrace(rtl_p, RTL_TRACE_PHY, 'W', location, val,
+			     rtl_regtrace_phy_page(rtl_p));
+
 	switch (rtl_p->mac_version) {
 	case RTL_GIGA_MAC_VER_28:
 	case RTL_GIGA_MAC_VER_31:
@@ -1092,17 +1593,174 @@ static void rtl_writephy(struct rtl8169_private *rtl_p, int location, int val)
 	}
 }
 
-static int rtl_readphy(struct rtl8169_private *rtl_p, int location)
+static int __rtl_readphy(struct rtl8169_private *rtl_p, int location)
 {
+	int val;
+
 	switch (rtl_p->mac_version) {
 	case RTL_GIGA_MAC_VER_28:
 	case RTL_GIGA_MAC_VER_31:
-		return r8168dp_2_mdio_read(rtl_p, location);
+		val = r8168dp_2_mdio_read(rtl_p, location);
+		break;
 	case RTL_GIGA_MAC_VER_40 ... RTL_GIGA_MAC_VER_63:
-		return r8168g_mdio_read(rtl_p, location);
+		val = r8168g_mdio_read(rtl_p, location);
+		break;
 	default:
-		return r8169_mdio_read(rtl_p, location);
+		val = r8169_mdio_read(rtl_p, location);
+		break;
+	}
+
+	if (location != 0x1f || rtl_p->mac_version < RTL_GIGA_MAC_VER_40)
+		rtl_regtrace(rtl_p, RTL_TRACE_PHY, 'R', location, val,
+			     rtl_regtrace_phy_page(rtl_p));
+
+	return val;
+}
+
+static void rtl_phy_shadow_flush(struct rtl8169_private *rtl_p)
+{
+	struct rtl_phy_shadow *sh = &rtl_p->phy_shadow;
+
+	memset(sh->key, 0, sizeof(sh->key));
+	sh->page_valid = false;
+}
+
+static void rtl_phy_shadow_begin(struct rtl8169_private *rtl_p)
+{
+	rtl_phy_shadow_flush(rtl_p);
+	rtl_p->phy_shadow.active = true;
+}
+
+static void rtl_phy_shadow_end(struct rtl8169_private *rtl_p)
+{
+	rtl_p->phy_shadow.active = false;
+	rtl_phy_shadow_flush(rtl_p);
+}
+
+/* RTL8168g and later select pages through ocp_base, no MDIO access needed */
+static bool rtl_phy_has_ocp_page(struct rtl8169_private *rtl_p)
+{
+	return rtl_p->mac_version >= RTL_GIGA_MAC_VER_40;
+}
+
+/* may the standard register page be selected? */
+static bool rtl_phy_std_page(struct rtl8169_private *rtl_p)
+{
+	struct rtl_phy_shadow *sh = &rtl_p->phy_shadow;
+
+	if (rtl_phy_has_ocp_page(rtl_p))
+		return rtl_p->ocp_base == OCP_STD_PHY_BASE;
+
+	return !sh->page_valid || !sh->page;
+}
+
+static bool rtl_phy_shadow_key(struct rtl8169_private *rtl_p, int reg, u32 *key)
+{
+	struct rtl_phy_shadow *sh = &rtl_p->phy_shadow;
+	u32 page;
+
+	if (rtl_phy_has_ocp_page(rtl_p))
+		page = rtl_p->ocp_base;
+	else if (sh->page_valid)
+		page = sh->page;
+	else
+		return false;
+
+	*key = RTL_PHY_SHADOW_VALID | page << 5 | reg;
+
+	return true;
+}
+
+static void rtl_phy_shadow_store(struct rtl8169_private *rtl_p, u32 key, u16 val)
+{
+	struct rtl_phy_shadow *sh = &rtl_p->phy_shadow;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sh->key); i++)
+		if ((sh->key[i] >> 5) == (key >> 5))
+			sh->key[i] = 0;
+
+	if ((key & 0x1f) < 0x10)
+		return;
+
+	i = hash_32(key, RTL_PHY_SHADOW_BITS);
+	sh->key[i] = key;
+	sh->val[i] = val;
+}
+
+static void rtl_writephy(struct rtl8169_private *rtl_p, int location, int val)
+{
+	struct rtl_phy_shadow *sh = &rtl_p->phy_shadow;
+	u32 key;
+
+	if (location == 0x1f && !rtl_phy_has_ocp_page(rtl_p)) {
+		if (sh->page_valid && sh->page == (u16)val) {
+			if (!sh->verify) {
+				sh->page_elided++;
+				return;
+			}
+			if (__rtl_readphy(rtl_p, 0x1f) != (u16)val)
+				sh->mismatches++;
+		}
+		__rtl_writephy(rtl_p, location, val);
+		sh->page = val;
+		sh->page_valid = true;
+		return;
+	}
+
+	__rtl_writephy(rtl_p, location, val);
+
+	if (location == 0x1f)
+		return;
+
+	if (location == MII_BMCR && val & BMCR_RESET && rtl_phy_std_page(rtl_p))
+		rtl_phy_shadow_flush(rtl_p);
+	else if (rtl_phy_shadow_key(rtl_p, location, &key))
+		rtl_phy_shadow_store(rtl_p, key, val);
+}
+
+static int rtl_readphy(struct rtl8169_private *rtl_p, int location)
+{
+	struct rtl_phy_shadow *sh = &rtl_p->phy_shadow;
+	int i, val;
+	u32 key;
+
+	if (location == 0x1f && !rtl_phy_has_ocp_page(rtl_p)) {
+		if (sh->page_valid && !sh->verify) {
+			sh->page_elided++;
+			return sh->page;
+		}
+		val = __rtl_readphy(rtl_p, location);
+		if (val >= 0) {
+			if (sh->page_valid && sh->page != val)
+				sh->mismatches++;
+			sh->page = val;
+			sh->page_valid = true;
+		}
+		return val;
 	}
+
+	if (!sh->active || !rtl_phy_shadow_key(rtl_p, location, &key))
+		return __rtl_readphy(rtl_p, location);
+
+	i = hash_32(key, RTL_PHY_SHADOW_BITS);
+	if (sh->key[i] != key)
+		return __rtl_readphy(rtl_p, location);
+
+	sh->hits++;
+	if (!sh->verify)
+		return sh->val[i];
+
+	val = __rtl_readphy(rtl_p, location);
+	if (val != sh->val[i]) {
+		sh->mismatches++;
+		if (net_ratelimit())
+			netdev_warn(rtl_p->netdev,
+				    "PHY shadow mismatch, key %08x: %04x != %04x\n",
+				    key, sh->val[i], val);
+	}
+
+	return val;
 }
 
 DECLARE_RTL_COND(rtl_ephyar_cond)
@@ -1112,6 +1770,7 @@ DECLARE_RTL_COND(rtl_ephyar_cond)
 
 static void rtl_ephy_write(struct rtl8169_private *rtl_p, int reg_addr, int value)
 {
+	rtl_regtrace(rtl_p, RTL_TRACE_EPHY, 'W', reg_addr, value, 0);
 	RTL_W32(rtl_p, EPHYAR, EPHYAR_WRITE_CMD | (value & EPHYAR_DATA_MASK) |
 		(reg_addr & EPHYAR_REG_MASK) << EPHYAR_REG_SHIFT);
 
@@ -1122,10 +1781,15 @@ static void rtl_ephy_write(struct rtl8169_private *rtl_p, int reg_addr, int valu
 
 static u16 rtl_ephy_read(struct rtl8169_private *rtl_p, int reg_addr)
 {
+	u16 val;
+
 	RTL_W32(rtl_p, EPHYAR, (reg_addr & EPHYAR_REG_MASK) << EPHYAR_REG_SHIFT);
 
-	return rtl_loop_wait_high(rtl_p, &rtl_ephyar_cond, 10, 100) ?
+	val = rtl_loop_wait_high(rtl_p, &rtl_ephyar_cond, 10, 100) ?
 		RTL_R32(rtl_p, EPHYAR) & EPHYAR_DATA_MASK : ~0;
+	rtl_regtrace(rtl_p, RTL_TRACE_EPHY, 'R', reg_addr, val, 0);
+
+	return val;
 }
 
 static u32 r8168dp_ocp_read(struct rtl8169_private *rtl_p, u16 reg)
@@ -1302,8 +1966,14 @@ u8 rtl8168d_efuse_read(struct rtl8169_private *rtl_p, int reg_addr)
 		RTL_R32(rtl_p, EFUSEAR) & EFUSEAR_DATA_MASK : ~0;
 }
 
+/*
+ * Interrupt status and mask accesses and the doorbell are the MMIO of the
+ * packet path, they are counted in sw_mmio_reads and sw_mmio_writes.
+ */
 static u32 rtl_get_events(struct rtl8169_private *rtl_p)
 {
+	rtl_sw_stat_inc(rtl_p, RTL_SW_MMIO_READ);
+
 	if (rtl_is_8125(rtl_p))
 		return RTL_R32(rtl_p, IntrStatus_8125);
 	else
@@ -1312,30 +1982,68 @@ static u32 rtl_get_events(struct rtl8169_private *rtl_p)
 
 static void rtl_ack_events(struct rtl8169_private *rtl_p, u32 bits)
 {
+	rtl_sw_stat_inc(rtl_p, RTL_SW_MMIO_WRITE);
+
 	if (rtl_is_8125(rtl_p))
 		RTL_W32(rtl_p, IntrStatus_8125, bits);
 	else
 		RTL_W16(rtl_p, IntrStatus, bits);
 }
 
-static void rtl_irq_disable(struct rtl8169_private *rtl_p)
+/*
+ * Only the driver changes IntrMask, apart from a chip reset or power loss
+ * clearing it. rtl8169_irq_mask_and_ack() runs before each rtl_hw_start()
+ * and resyncs the shadow, so masking an already masked chip can be skipped.
+ * Enabling always writes: a shadow raced by the interrupt handler must never
+ * leave the interrupts masked.
+ */
+static void rtl_write_irq_mask(struct rtl8169_private *rtl_p, u32 mask)
 {
+	if (!mask && !rtl_p->irq_mask_hw) {
+		rtl_sw_stat_inc(rtl_p, RTL_SW_MMIO_WRITE_ELIDED);
+		return;
+	}
+
+	rtl_p->irq_mask_hw = mask;
+	rtl_sw_stat_inc(rtl_p, RTL_SW_MMIO_WRITE);
+
 	if (rtl_is_8125(rtl_p))
-		RTL_W32(rtl_p, IntrMask_8125, 0);
+		RTL_W32(rtl_p, IntrMask_8125, mask);
 	else
-		RTL_W16(rtl_p, IntrMask, 0);
+		RTL_W16(rtl_p, IntrMask, mask);
+}
+
+static void rtl_irq_disable(struct rtl8169_private *rtl_p)
+{
+	rtl_write_irq_mask(rtl_p, 0);
 }
 
 static void rtl_irq_enable(struct rtl8169_private *rtl_p)
 {
-	if (rtl_is_8125(rtl_p))
-		RTL_W32(rtl_p, IntrMask_8125, rtl_p->irq_mask);
-	else
-		RTL_W16(rtl_p, IntrMask, rtl_p->irq_mask);
+	rtl_write_irq_mask(rtl_p, rtl_p->irq_mask);
+}
+
+/*
+ * On the PCIe chips up to RTL8117 IntrStatus directly follows IntrMask, so a
+ * single dword write masks all interrupts and acks the handled events. On
+ * RTL8125 the registers are 32 bit each and stay separate writes.
+ */
+static void rtl_irq_disable_and_ack(struct rtl8169_private *rtl_p, u32 bits)
+{
+	if (rtl_is_8125(rtl_p) || rtl_p->mac_version < RTL_GIGA_MAC_VER_07) {
+		rtl_irq_disable(rtl_p);
+		rtl_ack_events(rtl_p, bits);
+		return;
+	}
+
+	rtl_p->irq_mask_hw = 0;
+	rtl_sw_stat_inc(rtl_p, RTL_SW_MMIO_WRITE);
+	RTL_W32(rtl_p, IntrMask, (bits & 0xffff) << 16);
 }
 
 static void rtl8169_irq_mask_and_ack(struct rtl8169_private *rtl_p)
 {
+	rtl_p->irq_mask_hw = ~0;
 	rtl_irq_disable(rtl_p);
 	rtl_ack_events(rtl_p, 0xffffffff);
 	rtl_pci_commit(rtl_p);
@@ -1476,7 +2184,11 @@ static void rtl8169_get_drvinfo(struct net_device *netdev,
 				struct ethtool_drvinfo *info)
 {
 	struct rtl8169_private *rtl_p = netdev_priv(netdev);
-	struct rtl_fw *rtl_fw = rtl_p->rtl_fw;
+	struct rtl_fw *rtl_fw = NULL;
+
+	/* the firmware may still be loading */
+	if (completion_done(&rtl_p->fw_loaded))
+		rtl_fw = rtl_p->rtl_fw;
 
 	strscpy(info->driver, KBUILD_MODNAME, sizeof(info->driver));
 	strscpy(info->bus_info, pci_name(rtl_p->pcidev), sizeof(info->bus_info));
@@ -1531,6 +2243,7 @@ static int rtl8169_set_features(struct net_device *netdev,
 {
 	struct rtl8169_private *rtl_p = netdev_priv(netdev);
 
+	rtl_p->rpm.snap_valid = false;
 	rtl_set_rx_config_features(rtl_p, features);
 
 	if (features & NETIF_F_RXCSUM)
@@ -1593,11 +2306,112 @@ static const char rtl8169_gstrings[][ETH_GSTRING_LEN] = {
 	"tx_underrun",
 };
 
+static const char rtl8169_sw_gstrings[RTL_SW_STATS_NUM][ETH_GSTRING_LEN] = {
+	[RTL_SW_DOORBELL]		= "sw_doorbells",
+	[RTL_SW_DOORBELL_SUPPRESSED]	= "sw_doorbells_suppressed",
+	[RTL_SW_QUEUE_STOP]		= "sw_tx_queue_stops",
+	[RTL_SW_QUEUE_WAKE]		= "sw_tx_queue_wakes",
+	[RTL_SW_TX_RING_FULL]		= "sw_tx_ring_full",
+	[RTL_SW_TX_MAP_ERR]		= "sw_tx_map_errors",
+	[RTL_SW_RX_ALLOC_ERR]		= "sw_rx_alloc_errors",
+	[RTL_SW_RX_FRAG_DROP]		= "sw_rx_frag_drops",
+	[RTL_SW_NAPI_POLL]		= "sw_napi_polls",
+	[RTL_SW_NAPI_BUDGET_EXHAUSTED]	= "sw_napi_budget_exhausted",
+	[RTL_SW_IRQ_NONE]		= "sw_irq_none",
+	[RTL_SW_MMIO_READ]		= "sw_mmio_reads",
+	[RTL_SW_MMIO_WRITE]		= "sw_mmio_writes",
+	[RTL_SW_MMIO_WRITE_ELIDED]	= "sw_mmio_writes_elided",
+};
+
+static const struct ethtool_rmon_hist_range rtl_rmon_ranges[] = {
+	{    0,    64 },
+	{   65,   127 },
+	{  128,   255 },
+	{  256,   511 },
+	{  512,  1023 },
+	{ 1024,  1518 },
+	{ 1519,  2047 },
+	{ 2048, R8169_RX_BUF_SIZE },
+	{}
+};
+
+static_assert(ARRAY_SIZE(rtl_rmon_ranges) == RTL_RMON_BUCKETS + 1);
+
+/* frame length including FCS to rtl_rmon_ranges index */
+static unsigned int rtl_rmon_bucket(unsigned int len)
+{
+	if (len <= 64)
+		return 0;
+	if (len < 1024)
+		return fls(len) - 6;
+	if (len <= 1518)
+		return 5;
+	if (len < 2048)
+		return 6;
+
+	return 7;
+}
+
+static void rtl_rmon_count_tx(struct rtl8169_private *rtl_p,
+			      const struct sk_buff *skb)
+{
+	unsigned int vlan = skb_vlan_tag_present(skb) ? VLAN_HLEN : 0;
+	unsigned int mss = skb_shinfo(skb)->gso_size;
+	struct rtl_sw_stats __percpu *sw = rtl_p->sw_stats;
+	unsigned int len, payload;
+
+	if (!skb_is_gso(skb)) {
+		len = max_t(unsigned int, skb->len, ETH_ZLEN) + vlan + ETH_FCS_LEN;
+		this_cpu_inc(sw->tx_hist[rtl_rmon_bucket(len)]);
+		return;
+	}
+
+	/* TSO: account the frames the chip put on the wire */
+	len = skb_tcp_all_headers(skb);
+	payload = skb->len - len;
+	len += vlan + ETH_FCS_LEN;
+
+	this_cpu_add(sw->tx_hist[rtl_rmon_bucket(len + mss)], payload / mss);
+	if (payload % mss)
+		this_cpu_inc(sw->tx_hist[rtl_rmon_bucket(len + payload % mss)]);
+}
+
+static void rtl8169_get_rmon_stats(struct net_device *netdev,
+				   struct ethtool_rmon_stats *rmon_stats,
+				   const struct ethtool_rmon_hist_range **ranges)
+{
+	struct rtl8169_private *rtl_p = netdev_priv(netdev);
+	int cpu, i;
+
+	for (i = 0; i < RTL_RMON_BUCKETS; i++) {
+		rmon_stats->hist[i] = 0;
+		rmon_stats->hist_tx[i] = 0;
+	}
+
+	for_each_possible_cpu(cpu) {
+		const struct rtl_sw_stats *sw = per_cpu_ptr(rtl_p->sw_stats, cpu);
+
+		for (i = 0; i < RTL_RMON_BUCKETS; i++) {
+			rmon_stats->hist[i] += READ_ONCE(sw->rx_hist[i]);
+			rmon_stats->hist_tx[i] += READ_ONCE(sw->tx_hist[i]);
+		}
+	}
+
+	*ranges = rtl_rmon_ranges;
+}
+
+static const char rtl8169_priv_flags_strings[][ETH_GSTRING_LEN] = {
+	"retain-rings",
+	"eee-adaptive",
+};
+
 static int rtl8169_get_sset_count(struct net_device *netdev, int sset)
 {
 	switch (sset) {
 	case ETH_SS_STATS:
-		return ARRAY_SIZE(rtl8169_gstrings);
+		return ARRAY_SIZE(rtl8169_gstrings) + RTL_SW_STATS_NUM;
+	case ETH_SS_PRIV_FLAGS:
+		return ARRAY_SIZE(rtl8169_priv_flags_strings);
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -1672,6 +2486,7 @@ static void rtl8169_get_ethtool_stats(struct net_device *netdev,
 {
 	struct rtl8169_private *rtl_p = netdev_priv(netdev);
 	struct rtl8169_counters *counters;
+	int cpu, i;
 
 	counters = rtl_p->counters;
 	rtl8169_update_counters(rtl_p);
@@ -1689,15 +2504,62 @@ static void rtl8169_get_ethtool_stats(struct net_device *netdev,
 	data[10] = le32_to_cpu(counters->rx_multicast);
 	data[11] = le16_to_cpu(counters->tx_aborted);
 	data[12] = le16_to_cpu(counters->tx_underun);
-}
+
+	data += ARRAY_SIZE(rtl8169_gstrings);
+	memset(data, 0, RTL_SW_STATS_NUM * sizeof(*data));
+	for_each_possible_cpu(cpu) {
+		const struct rtl_sw_stats *sw = per_cpu_ptr(rtl_p->sw_stats, cpu);
+
+		for (i = 0; i < RTL_SW_STATS_NUM; i++)
+			data[i] += READ_ONCE(sw->cnt[i]);
+	}
+}
 
 static void rtl8169_get_strings(struct net_device *netdev, u32 stringset, u8 *data)
 {
 	switch(stringset) {
 	case ETH_SS_STATS:
 		memcpy(data, rtl8169_gstrings, sizeof(rtl8169_gstrings));
+		data += sizeof(rtl8169_gstrings);
+		memcpy(data, rtl8169_sw_gstrings, sizeof(rtl8169_sw_gstrings));
 		break;
+	case ETH_SS_PRIV_FLAGS:
+		memcpy(data, rtl8169_priv_flags_strings,
+		       sizeof(rtl8169_priv_flags_strings));
+		break;
+	}
+}
+
+static void rtl_pool_free(struct rtl8169_private *rtl_p);
+static void rtl_load_policy_update(struct rtl8169_private *rtl_p);
+
+static u32 rtl8169_get_priv_flags(struct net_device *netdev)
+{
+	struct rtl8169_private *rtl_p = netdev_priv(netdev);
+
+	return rtl_p->priv_flags;
+}
+
+static int rtl8169_set_priv_flags(struct net_device *netdev, u32 flags)
+{
+	struct rtl8169_private *rtl_p = netdev_priv(netdev);
+	u32 changed = rtl_p->priv_flags ^ flags;
+
+	if ((flags & RTL_PRIV_FLAG_EEE_ADAPTIVE) && !rtl_supports_eee(rtl_p))
+		return -EOPNOTSUPP;
+
+	if (!(flags & RTL_PRIV_FLAG_RETAIN_RINGS)) {
+		mutex_lock(&rtl_p->pool.lock);
+		rtl_pool_free(rtl_p);
+		mutex_unlock(&rtl_p->pool.lock);
 	}
+
+	rtl_p->priv_flags = flags;
+
+	if (changed & RTL_PRIV_FLAG_EEE_ADAPTIVE)
+		rtl_load_policy_update(rtl_p);
+
+	return 0;
 }
 
 /*
@@ -1836,21 +2698,15 @@ static int rtl_coalesce_choose_scale(struct rtl8169_private *rtl_p, u32 usec,
 	return -ERANGE;
 }
 
-static int rtl_set_coalesce(struct net_device *netdev,
-			    struct ethtool_coalesce *ec,
-			    struct kernel_ethtool_coalesce *kernel_coal,
-			    struct netlink_ext_ack *extack)
+static int __rtl_set_coalesce(struct rtl8169_private *rtl_p,
+			      const struct ethtool_coalesce *ec)
 {
-	struct rtl8169_private *rtl_p = netdev_priv(netdev);
 	u32 tx_fr = ec->tx_max_coalesced_frames;
 	u32 rx_fr = ec->rx_max_coalesced_frames;
 	u32 coal_usec_max, units;
 	u16 w = 0, cp01 = 0;
 	int scale;
 
-	if (rtl_is_8125(rtl_p))
-		return -EOPNOTSUPP;
-
 	if (rx_fr > RTL_COALESCE_FRAME_MAX || tx_fr > RTL_COALESCE_FRAME_MAX)
 		return -ERANGE;
 
@@ -1888,6 +2744,8 @@ static int rtl_set_coalesce(struct net_device *netdev,
 	w |= FIELD_PREP(RTL_COALESCE_RX_USECS, units);
 
 	RTL_W16(rtl_p, IntrMitigate, w);
+	/* don't let a runtime resume restore the old value */
+	rtl_p->rpm.snap_valid = false;
 
 	/* Meaning of PktCntrDisable bit changed from RTL8168e-vl */
 	if (rtl_is_8168evl_up(rtl_p)) {
@@ -1905,14 +2763,87 @@ static int rtl_set_coalesce(struct net_device *netdev,
 	return 0;
 }
 
+static int rtl_set_coalesce(struct net_device *netdev,
+			    struct ethtool_coalesce *ec,
+			    struct kernel_ethtool_coalesce *kernel_coal,
+			    struct netlink_ext_ack *extack)
+{
+	struct rtl8169_private *rtl_p = netdev_priv(netdev);
+	int ret;
+
+	if (rtl_is_8125(rtl_p))
+		return -EOPNOTSUPP;
+
+	ret = __rtl_set_coalesce(rtl_p, ec);
+	if (ret)
+		return ret;
+
+	rtl_p->coal = *ec;
+	rtl_p->coal_set = true;
+
+	return 0;
+}
+
+/*
+ * The scale depends on the link speed, so reapply after each link up. If
+ * the chip is runtime suspended, the link up after its resume does it.
+ */
+static void rtl_coalesce_work(struct rtl8169_private *rtl_p)
+{
+	struct device *d = tp_to_dev(rtl_p);
+
+	if (pm_runtime_get_if_active(d, true) <= 0)
+		return;
+
+	if (__rtl_set_coalesce(rtl_p, &rtl_p->coal))
+		netdev_info(rtl_p->netdev, "interrupt coalescing not applied at this speed\n");
+
+	pm_runtime_put_noidle(d);
+}
+
+/* MAC side of EEE only, the advertisement and thus the link stay as is */
+static void rtl_eee_mac_lpi(struct rtl8169_private *rtl_p, bool enable)
+{
+	if (rtl_is_8125(rtl_p))
+		r8168_mac_ocp_modify(rtl_p, 0xe040, enable ? 0 : BIT(1) | BIT(0),
+				     enable ? BIT(1) | BIT(0) : 0);
+	else if (enable)
+		rtl_eri_set_bits(rtl_p, 0x1b0, 0x0003);
+	else
+		rtl_eri_clear_bits(rtl_p, 0x1b0, 0x0003);
+}
+
+static bool rtl_eee_lpi_wanted(struct rtl8169_private *rtl_p)
+{
+	return rtl_p->eee.tx_lpi && !rtl_p->eee.busy;
+}
+
+static void rtl_eee_set_busy(struct rtl8169_private *rtl_p, bool busy)
+{
+	rtl_p->eee.busy = busy;
+	rtl_p->eee.quiet = 0;
+	if (busy)
+		rtl_p->eee.to_busy++;
+	else
+		rtl_p->eee.to_idle++;
+
+	if (rtl_supports_eee(rtl_p))
+		rtl_eee_mac_lpi(rtl_p, rtl_eee_lpi_wanted(rtl_p));
+}
+
 static int rtl8169_get_eee(struct net_device *netdev, struct ethtool_eee *data)
 {
 	struct rtl8169_private *rtl_p = netdev_priv(netdev);
+	int ret;
 
 	if (!rtl_supports_eee(rtl_p))
 		return -EOPNOTSUPP;
 
-	return phy_ethtool_get_eee(rtl_p->phydev, data);
+	ret = phy_ethtool_get_eee(rtl_p->phydev, data);
+	if (!ret)
+		data->tx_lpi_enabled = rtl_p->eee.tx_lpi;
+
+	return ret;
 }
 
 static int rtl8169_set_eee(struct net_device *netdev, struct ethtool_eee *data)
@@ -1924,11 +2855,18 @@ static int rtl8169_set_eee(struct net_device *netdev, struct ethtool_eee *data)
 		return -EOPNOTSUPP;
 
 	ret = phy_ethtool_set_eee(rtl_p->phydev, data);
+	if (ret)
+		return ret;
 
-	if (!ret)
-		rtl_p->eee_adv = phy_read_mmd(netdev->phydev, MDIO_MMD_AN,
-					   MDIO_AN_EEE_ADV);
-	return ret;
+	rtl_p->eee_adv = phy_read_mmd(netdev->phydev, MDIO_MMD_AN,
+				      MDIO_AN_EEE_ADV);
+
+	/* LPI can be switched without renegotiating the link */
+	rtl_p->eee.tx_lpi = data->tx_lpi_enabled;
+	if (test_bit(RTL_FLAG_TASK_ENABLED, rtl_p->wk.flags))
+		rtl_eee_mac_lpi(rtl_p, rtl_eee_lpi_wanted(rtl_p));
+
+	return 0;
 }
 
 static void rtl8169_get_ringparam(struct net_device *netdev,
@@ -1991,6 +2929,9 @@ static const struct ethtool_ops rtl8169_ethtool_ops = {
 	.get_ringparam		= rtl8169_get_ringparam,
 	.get_pauseparam		= rtl8169_get_pauseparam,
 	.set_pauseparam		= rtl8169_set_pauseparam,
+	.get_priv_flags		= rtl8169_get_priv_flags,
+	.set_priv_flags		= rtl8169_set_priv_flags,
+	.get_rmon_stats		= rtl8169_get_rmon_stats,
 };
 
 static void rtl_enable_eee(struct rtl8169_private *rtl_p)
@@ -2142,6 +3083,7 @@ static enum mac_version rtl8169_get_mac_version(u16 xid, bool gmii)
 
 static void rtl_release_firmware(struct rtl8169_private *rtl_p)
 {
+	wait_for_completion(&rtl_p->fw_loaded);
 	if (rtl_p->rtl_fw) {
 		rtl_fw_release_firmware(rtl_p->rtl_fw);
 		kfree(rtl_p->rtl_fw);
@@ -2151,13 +3093,23 @@ static void rtl_release_firmware(struct rtl8169_private *rtl_p)
 
 void r8169_apply_firmware(struct rtl8169_private *rtl_p)
 {
+	bool shadow = rtl_p->phy_shadow.active;
+	ktime_t start;
 	int val;
 
 	/* TODO: release firmware if rtl_fw_write_firmware signals failure. */
 	if (rtl_p->rtl_fw) {
+		/* firmware polls MCU handshake bits, its reads must hit the PHY */
+		rtl_p->phy_shadow.active = false;
+		start = ktime_get();
 		rtl_fw_write_firmware(rtl_p, rtl_p->rtl_fw);
+		rtl_p->fw_apply_us = ktime_us_delta(ktime_get(), start);
+		rtl_p->fw_applied++;
 		/* At least one firmware doesn't reset rtl_p->ocp_base. */
 		rtl_p->ocp_base = OCP_STD_PHY_BASE;
+		/* the PHY MCU may have changed registers behind our back */
+		rtl_phy_shadow_flush(rtl_p);
+		rtl_p->phy_shadow.active = shadow;
 
 		/* PHY soft reset may still be in progress */
 		phy_read_poll_timeout(rtl_p->phydev, MII_BMCR, val,
@@ -2222,9 +3174,71 @@ static void rtl_schedule_task(struct rtl8169_private *rtl_p, enum rtl_flag flag)
 	schedule_work(&rtl_p->wk.work);
 }
 
-static void rtl8169_init_phy(struct rtl8169_private *rtl_p)
+/*
+ * PHY parameter holding the PHY MCU RAM code version. The firmware sets it
+ * and it is reset when the PHY loses power. It is only read: if the PHY
+ * config changed it, finding the same value on resume means the config is
+ * still applied.
+ */
+#define RTL_PHY_SIG_PARAM	0x801e
+
+static bool rtl_phy_sig_supported(struct rtl8169_private *rtl_p)
+{
+	/* MAC MCU patches don't survive a MAC reset */
+	return rtl_p->mac_version >= RTL_GIGA_MAC_VER_40 && rtl_p->rtl_fw &&
+	       !rtl_p->rtl_fw->mac_mcu;
+}
+
+static int rtl_phy_sig_read(struct rtl8169_private *rtl_p)
+{
+	struct phy_device *phydev = rtl_p->phydev;
+	int oldpage, val;
+
+	oldpage = phy_select_page(phydev, 0x0a43);
+	__phy_write(phydev, 0x13, RTL_PHY_SIG_PARAM);
+	val = __phy_read(phydev, 0x14);
+
+	return phy_restore_page(phydev, oldpage, val);
+}
+
+static bool rtl_phy_config_intact(struct rtl8169_private *rtl_p)
 {
+	return rtl_p->phy_sig_valid && rtl_phy_sig_supported(rtl_p) &&
+	       rtl_phy_sig_read(rtl_p) == rtl_p->phy_sig;
+}
+
+static void rtl8169_init_phy(struct rtl8169_private *rtl_p, bool resume)
+{
+	bool sig_valid = rtl_p->phy_sig_valid;
+	ktime_t start = ktime_get();
+	int old_sig = -ENODEV;
+	int sig;
+
+	if (resume && rtl_phy_config_intact(rtl_p)) {
+		rtl_p->phy_config_skipped++;
+		goto config_done;
+	}
+
+	rtl_p->phy_sig_valid = false;
+	if (rtl_phy_sig_supported(rtl_p))
+		old_sig = rtl_phy_sig_read(rtl_p);
+
+	rtl_regtrace_begin(rtl_p, RTL_TRACE_PHY_CONFIG);
+	rtl_phy_shadow_begin(rtl_p);
 	r8169_hw_phy_config(rtl_p, rtl_p->phydev, rtl_p->mac_version);
+	rtl_phy_shadow_end(rtl_p);
+	rtl_regtrace_end(rtl_p);
+
+	/* an unchanged value only counts if it was known to be ours */
+	if (old_sig >= 0) {
+		sig = rtl_phy_sig_read(rtl_p);
+		rtl_p->phy_sig_valid = sig >= 0 &&
+				       (sig != old_sig ||
+					(sig_valid && sig == rtl_p->phy_sig));
+		rtl_p->phy_sig = sig;
+	}
+config_done:
+	rtl_p->phy_config_us = ktime_us_delta(ktime_get(), start);
 
 	if (rtl_p->mac_version <= RTL_GIGA_MAC_VER_06) {
 		pci_write_config_byte(rtl_p->pcidev, PCI_LATENCY_TIMER, 0x40);
@@ -2395,8 +3409,12 @@ static void rtl_jumbo_config(struct rtl8169_private *rtl_p)
 	if (pci_is_pcie(rtl_p->pcidev) && rtl_p->supports_gmii)
 		pcie_set_readrq(rtl_p->pcidev, readrq);
 
-	/* Chip doesn't support pause in jumbo mode */
-	if (jumbo) {
+	/* Chip doesn't support pause in jumbo mode, renegotiate only once */
+	if (jumbo &&
+	    (linkmode_test_bit(ETHTOOL_LINK_MODE_Pause_BIT,
+			       rtl_p->phydev->advertising) ||
+	     linkmode_test_bit(ETHTOOL_LINK_MODE_Asym_Pause_BIT,
+			       rtl_p->phydev->advertising))) {
 		linkmode_clear_bit(ETHTOOL_LINK_MODE_Pause_BIT,
 				   rtl_p->phydev->advertising);
 		linkmode_clear_bit(ETHTOOL_LINK_MODE_Asym_Pause_BIT,
@@ -2417,17 +3435,35 @@ static void rtl_hw_reset(struct rtl8169_private *rtl_p)
 	rtl_loop_wait_low(rtl_p, &rtl_chipcmd_cond, 100, 100);
 }
 
+static void rtl_fw_load_done(void *context, struct rtl_fw *rtl_fw, int rc)
+{
+	struct rtl8169_private *rtl_p = context;
+
+	if (rc)
+		kfree(rtl_fw);
+	else
+		rtl_p->rtl_fw = rtl_fw;
+
+	complete_all(&rtl_p->fw_loaded);
+}
+
+/*
+ * Started at probe, rtl_open() waits for it in rtl_wait_firmware() and
+ * requests it again if it wasn't available.
+ */
 static void rtl_request_firmware(struct rtl8169_private *rtl_p)
 {
 	struct rtl_fw *rtl_fw;
 
-	/* firmware loaded already or no firmware available */
-	if (rtl_p->rtl_fw || !rtl_p->fw_name)
-		return;
+	reinit_completion(&rtl_p->fw_loaded);
+
+	/* no firmware available */
+	if (!rtl_p->fw_name)
+		goto out;
 
 	rtl_fw = kzalloc(sizeof(*rtl_fw), GFP_KERNEL);
 	if (!rtl_fw)
-		return;
+		goto out;
 
 	rtl_fw->phy_write = rtl_writephy;
 	rtl_fw->phy_read = rtl_readphy;
@@ -2435,11 +3471,27 @@ static void rtl_request_firmware(struct rtl8169_private *rtl_p)
 	rtl_fw->mac_mcu_read = mac_mcu_read;
 	rtl_fw->fw_name = rtl_p->fw_name;
 	rtl_fw->dev = tp_to_dev(rtl_p);
+	rtl_fw->done = rtl_fw_load_done;
+	rtl_fw->context = rtl_p;
 
-	if (rtl_fw_request_firmware(rtl_fw))
-		kfree(rtl_fw);
-	else
-		rtl_p->rtl_fw = rtl_fw;
+	rtl_fw_request_firmware_nowait(rtl_fw);
+	return;
+out:
+	complete_all(&rtl_p->fw_loaded);
+}
+
+static void rtl_wait_firmware(struct rtl8169_private *rtl_p)
+{
+	ktime_t start = ktime_get();
+
+	wait_for_completion(&rtl_p->fw_loaded);
+
+	/* probe may have run before the firmware was reachable, e.g. initramfs */
+	if (!rtl_p->rtl_fw && rtl_p->fw_name) {
+		rtl_request_firmware(rtl_p);
+		wait_for_completion(&rtl_p->fw_loaded);
+	}
+	rtl_p->fw_wait_us = ktime_us_delta(ktime_get(), start);
 }
 
 static void rtl_rx_close(struct rtl8169_private *rtl_p)
@@ -2462,6 +3514,11 @@ DECLARE_RTL_COND(rtl_rxtx_empty_cond)
 	return (RTL_R8(rtl_p, MCU) & RXTX_EMPTY) == RXTX_EMPTY;
 }
 
+DECLARE_RTL_COND(rtl_tx_empty_cond)
+{
+	return RTL_R8(rtl_p, MCU) & TX_EMPTY;
+}
+
 DECLARE_RTL_COND(rtl_rxtx_empty_cond_2)
 {
 	/* IntrMitigate has new functionality on RTL8125 */
@@ -2520,7 +3577,8 @@ static void rtl_prepare_power_down(struct rtl8169_private *rtl_p)
 		rtl_ephy_write(rtl_p, 0x19, 0xff64);
 
 	if (device_may_wakeup(tp_to_dev(rtl_p))) {
-		phy_speed_down(rtl_p->phydev, false);
+		if (!rtl_p->rpm.keep_link)
+			phy_speed_down(rtl_p->phydev, false);
 		rtl_wol_enable_rx(rtl_p);
 	}
 }
@@ -2677,14 +3735,206 @@ static void __rtl_ephy_init(struct rtl8169_private *rtl_p,
 	u16 w;
 
 	while (len-- > 0) {
-		w = (rtl_ephy_read(rtl_p, e->offset) & ~e->mask) | e->bits;
+		/* a full-width mask is a plain write, skip the slow read */
+		if (e->mask == 0xffff) {
+			w = e->bits;
+			rtl_p->script.reads_elided++;
+		} else {
+			w = (rtl_ephy_read(rtl_p, e->offset) & ~e->mask) | e->bits;
+			rtl_p->script.reads++;
+		}
 		rtl_ephy_write(rtl_p, e->offset, w);
+		rtl_p->script.writes++;
 		e++;
 	}
 }
 
 #define rtl_ephy_init(rtl_p, a) __rtl_ephy_init(rtl_p, a, ARRAY_SIZE(a))
 
+/*
+ * Register scripts: chip init sequences as tables. __rtl_run_script() merges
+ * adjacent read-modify-writes of the same register that touch disjoint bits,
+ * turns full-width modifies into plain writes, holds mac_ocp_lock across runs
+ * of MAC OCP accesses and unlocks the config registers once per script.
+ */
+enum rtl_script_space {
+	RTL_MMIO8,
+	RTL_MMIO16,
+	RTL_MMIO32,
+	RTL_ERI8,
+	RTL_ERI16,
+	RTL_ERI32,
+	RTL_MAC_OCP,
+	RTL_EPHY,
+};
+
+enum rtl_script_op {
+	RTL_OP_WRITE,
+	RTL_OP_MODIFY,
+	RTL_OP_DELAY,
+};
+
+struct rtl_script_cmd {
+	u8 op;
+	u8 space;
+	u16 addr;
+	u32 mask;
+	u32 val;
+};
+
+#define RTL_SCR_W(space, addr, val)	{ RTL_OP_WRITE, space, addr, 0, val }
+#define RTL_SCR_M(space, addr, mask, set) \
+	{ RTL_OP_MODIFY, space, addr, mask, set }
+#define RTL_SCR_UDELAY(us)		{ RTL_OP_DELAY, 0, 0, 0, us }
+
+/* bound the time spent with mac_ocp_lock held and irqs off */
+#define RTL_SCRIPT_OCP_BATCH	16
+
+static u32 rtl_script_width(u8 space)
+{
+	switch (space) {
+	case RTL_MMIO8:
+	case RTL_ERI8:
+		return 0xff;
+	case RTL_MMIO16:
+	case RTL_ERI16:
+	case RTL_MAC_OCP:
+	case RTL_EPHY:
+		return 0xffff;
+	default:
+		return ~0U;
+	}
+}
+
+static u32 rtl_script_read(struct rtl8169_private *rtl_p, u8 space, u16 addr)
+{
+	rtl_p->script.reads++;
+
+	switch (space) {
+	case RTL_MMIO8:
+		return RTL_R8(rtl_p, addr);
+	case RTL_MMIO16:
+		return RTL_R16(rtl_p, addr);
+	case RTL_MMIO32:
+		return RTL_R32(rtl_p, addr);
+	case RTL_ERI8:
+	case RTL_ERI16:
+	case RTL_ERI32:
+		return rtl_eri_read(rtl_p, addr);
+	case RTL_MAC_OCP:
+		return __r8168_mac_ocp_read(rtl_p, addr);
+	case RTL_EPHY:
+		return rtl_ephy_read(rtl_p, addr);
+	}
+
+	return 0;
+}
+
+static void rtl_script_write(struct rtl8169_private *rtl_p, u8 space, u16 addr,
+			     u32 val)
+{
+	rtl_p->script.writes++;
+
+	switch (space) {
+	case RTL_MMIO8:
+		RTL_W8(rtl_p, addr, val);
+		break;
+	case RTL_MMIO16:
+		RTL_W16(rtl_p, addr, val);
+		break;
+	case RTL_MMIO32:
+		RTL_W32(rtl_p, addr, val);
+		break;
+	case RTL_ERI8:
+		rtl_eri_write(rtl_p, addr, ERIAR_MASK_0001, val);
+		break;
+	case RTL_ERI16:
+		rtl_eri_write(rtl_p, addr, ERIAR_MASK_0011, val);
+		break;
+	case RTL_ERI32:
+		rtl_eri_write(rtl_p, addr, ERIAR_MASK_1111, val);
+		break;
+	case RTL_MAC_OCP:
+		__r8168_mac_ocp_write(rtl_p, addr, val);
+		break;
+	case RTL_EPHY:
+		rtl_ephy_write(rtl_p, addr, val);
+		break;
+	}
+}
+
+static bool rtl_script_can_merge(const struct rtl_script_cmd *a,
+				 const struct rtl_script_cmd *b, u32 touched)
+{
+	/* overlapping bits may be a deliberate pulse, keep both accesses */
+	return b->op == RTL_OP_MODIFY && b->space == a->space &&
+	       b->addr == a->addr && !(touched & (b->mask | b->val));
+}
+
+static void __rtl_run_script(struct rtl8169_private *rtl_p,
+			     const struct rtl_script_cmd *s, int len)
+{
+	const struct rtl_script_cmd *end = s + len;
+	bool cfg_unlocked = false;
+	unsigned long flags;
+	int ocp_batch = 0;
+
+	for (; s < end; s++) {
+		u32 width = rtl_script_width(s->space);
+		u32 mask = s->mask, val = s->val;
+
+		rtl_p->script.ops++;
+
+		if (ocp_batch && (s->space != RTL_MAC_OCP ||
+				  s->op == RTL_OP_DELAY ||
+				  ocp_batch == RTL_SCRIPT_OCP_BATCH)) {
+			raw_spin_unlock_irqrestore(&rtl_p->mac_ocp_lock, flags);
+			ocp_batch = 0;
+		}
+
+		if (s->op == RTL_OP_DELAY) {
+			mdelay(s->val / 1000);
+			udelay(s->val % 1000);
+			continue;
+		}
+
+		if (!cfg_unlocked && s->space == RTL_MMIO8 &&
+		    s->addr >= Config0 && s->addr <= Config5) {
+			rtl_unlock_config_regs(rtl_p);
+			cfg_unlocked = true;
+		}
+
+		if (s->space == RTL_MAC_OCP && !ocp_batch++)
+			raw_spin_lock_irqsave(&rtl_p->mac_ocp_lock, flags);
+
+		if (s->op == RTL_OP_MODIFY) {
+			while (s + 1 < end &&
+			       rtl_script_can_merge(s, s + 1, mask | val)) {
+				s++;
+				mask |= s->mask;
+				val = (val & ~s->mask) | s->val;
+				rtl_p->script.ops++;
+				rtl_p->script.merged++;
+			}
+
+			if ((mask & width) == width)
+				rtl_p->script.reads_elided++;
+			else
+				val |= rtl_script_read(rtl_p, s->space,
+						       s->addr) & ~mask;
+		}
+
+		rtl_script_write(rtl_p, s->space, s->addr, val & width);
+	}
+
+	if (ocp_batch)
+		raw_spin_unlock_irqrestore(&rtl_p->mac_ocp_lock, flags);
+	if (cfg_unlocked)
+		rtl_lock_config_regs(rtl_p);
+}
+
+#define rtl_run_script(rtl_p, a) __rtl_run_script(rtl_p, a, ARRAY_SIZE(a))
+
 static void rtl_disable_clock_request(struct rtl8169_private *rtl_p)
 {
 	pcie_capability_clear_word(rtl_p->pcidev, PCI_EXP_LNKCTL,
@@ -2785,83 +4035,369 @@ static void rtl_hw_aspm_clkreq_enable(struct rtl8169_private *rtl_p, bool enable
 	}
 }
 
-static void rtl_set_fifo_size(struct rtl8169_private *rtl_p, u16 rx_stat,
-			      u16 tx_stat, u16 rx_dyn, u16 tx_dyn)
+#define RTL_LOAD_SAMPLE_MS	100
+/* samples below low_pps before ASPM is enabled again */
+#define RTL_ASPM_QUIET_SAMPLES	20
+#define RTL_ASPM_HIGH_PPS	20000
+#define RTL_ASPM_LOW_PPS	2000
+/* any sustained traffic keeps LPI off, 1 s of quiet turns it on again */
+#define RTL_EEE_BUSY_PPS	500
+#define RTL_EEE_QUIET_SAMPLES	10
+
+static bool rtl_aspm_dynamic_supported(struct rtl8169_private *rtl_p)
 {
-	/* Usage of dynamic vs. static FIFO is controlled by bit
-	 * TXCFG_AUTO_FIFO. Exact meaning of FIFO values isn't known.
-	 */
-	rtl_eri_write(rtl_p, 0xc8, ERIAR_MASK_1111, (rx_stat << 16) | rx_dyn);
-	rtl_eri_write(rtl_p, 0xe8, ERIAR_MASK_1111, (tx_stat << 16) | tx_dyn);
+	return rtl_p->mac_version >= RTL_GIGA_MAC_VER_32 &&
+	       rtl_p->mac_version != RTL_GIGA_MAC_VER_42 &&
+	       rtl_p->mac_version != RTL_GIGA_MAC_VER_43 &&
+	       rtl_p->aspm_manageable;
 }
 
-static void rtl8168g_set_pause_thresholds(struct rtl8169_private *rtl_p,
-					  u8 low, u8 high)
+static void rtl_aspm_set_busy(struct rtl8169_private *rtl_p, bool busy)
 {
-	/* FIFO thresholds for pause flow control */
-	rtl_eri_write(rtl_p, 0xcc, ERIAR_MASK_0001, low);
-	rtl_eri_write(rtl_p, 0xd0, ERIAR_MASK_0001, high);
+	rtl_unlock_config_regs(rtl_p);
+	if (busy) {
+		rtl_hw_aspm_clkreq_enable(rtl_p, false);
+		rtl_p->aspm.to_busy++;
+	} else {
+		/* the exit-L1 events must be armed before L1 can be entered */
+		rtl_enable_exit_l1(rtl_p);
+		rtl_hw_aspm_clkreq_enable(rtl_p, true);
+		rtl_p->aspm.to_idle++;
+	}
+	rtl_lock_config_regs(rtl_p);
+
+	rtl_p->aspm.busy = busy;
+	rtl_p->aspm.quiet = 0;
 }
 
-static void rtl_hw_start_8168b(struct rtl8169_private *rtl_p)
+/*
+ * L1 exit latency hurts under load, so ASPM and ClkReq go off as soon as
+ * the packet rate exceeds high_pps and only come back after the rate
+ * stayed below low_pps for RTL_ASPM_QUIET_SAMPLES samples.
+ */
+static bool rtl_aspm_want_busy(struct rtl8169_private *rtl_p, u32 pps)
 {
-	RTL_W8(rtl_p, Config3, RTL_R8(rtl_p, Config3) & ~Beacon_en);
+	if (!rtl_p->aspm.dynamic)
+		return rtl_p->aspm.off;
+
+	if (!rtl_p->aspm.busy)
+		return pps >= READ_ONCE(rtl_p->aspm.high_pps);
+
+	if (pps >= READ_ONCE(rtl_p->aspm.low_pps))
+		rtl_p->aspm.quiet = 0;
+	else if (++rtl_p->aspm.quiet >= RTL_ASPM_QUIET_SAMPLES)
+		return false;
+
+	return true;
 }
 
-static void __rtl_hw_start_8168cp(struct rtl8169_private *rtl_p)
+/* LPI wake-up delays the first packet after idle, same scheme as ASPM */
+static bool rtl_eee_want_busy(struct rtl8169_private *rtl_p, u32 pps)
 {
-	RTL_W8(rtl_p, Config1, RTL_R8(rtl_p, Config1) | Speed_down);
+	if (!(rtl_p->priv_flags & RTL_PRIV_FLAG_EEE_ADAPTIVE))
+		return false;
 
-	RTL_W8(rtl_p, Config3, RTL_R8(rtl_p, Config3) & ~Beacon_en);
+	if (pps >= RTL_EEE_BUSY_PPS)
+		rtl_p->eee.quiet = 0;
+	else if (!rtl_p->eee.busy ||
+		 ++rtl_p->eee.quiet >= RTL_EEE_QUIET_SAMPLES)
+		return false;
 
-	rtl_disable_clock_request(rtl_p);
+	return true;
 }
 
-static void rtl_hw_start_8168cp_1(struct rtl8169_private *rtl_p)
+static void rtl_load_work(struct work_struct *work)
 {
-	static const struct ephy_info e_info_8168cp[] = {
-		{ 0x01, 0,	0x0001 },
-		{ 0x02, 0x0800,	0x1000 },
-		{ 0x03, 0,	0x0042 },
-		{ 0x06, 0x0080,	0x0000 },
-		{ 0x07, 0,	0x2000 }
-	};
+	struct rtl8169_private *rtl_p = container_of(to_delayed_work(work),
+						  struct rtl8169_private,
+						  load.work);
+	u32 pkts = READ_ONCE(rtl_p->load.pkts);
+	bool aspm_busy, eee_busy;
 
-	rtl_set_def_aspm_entry_latency(rtl_p);
+	rtl_p->load.pps = (pkts - rtl_p->load.last_pkts) *
+			  (MSEC_PER_SEC / RTL_LOAD_SAMPLE_MS);
+	rtl_p->load.last_pkts = pkts;
 
-	rtl_ephy_init(rtl_p, e_info_8168cp);
+	aspm_busy = rtl_aspm_want_busy(rtl_p, rtl_p->load.pps);
+	eee_busy = rtl_eee_want_busy(rtl_p, rtl_p->load.pps);
 
-	__rtl_hw_start_8168cp(rtl_p);
+	/* rtl8169_down() cancels us with RTNL held, retry on the next sample */
+	if ((aspm_busy != rtl_p->aspm.busy || eee_busy != rtl_p->eee.busy) &&
+	    rtnl_trylock()) {
+		if (test_bit(RTL_FLAG_TASK_ENABLED, rtl_p->wk.flags)) {
+			if (aspm_busy != rtl_p->aspm.busy)
+				rtl_aspm_set_busy(rtl_p, aspm_busy);
+			if (eee_busy != rtl_p->eee.busy)
+				rtl_eee_set_busy(rtl_p, eee_busy);
+		}
+		rtnl_unlock();
+	}
+
+	schedule_delayed_work(&rtl_p->load.work,
+			      msecs_to_jiffies(RTL_LOAD_SAMPLE_MS));
 }
 
-static void rtl_hw_start_8168cp_2(struct rtl8169_private *rtl_p)
+static void rtl_load_policy_start(struct rtl8169_private *rtl_p)
 {
-	rtl_set_def_aspm_entry_latency(rtl_p);
+	if (!rtl_p->aspm.dynamic &&
+	    !(rtl_p->priv_flags & RTL_PRIV_FLAG_EEE_ADAPTIVE))
+		return;
 
-	RTL_W8(rtl_p, Config3, RTL_R8(rtl_p, Config3) & ~Beacon_en);
+	rtl_p->load.last_pkts = READ_ONCE(rtl_p->load.pkts);
+	rtl_p->aspm.quiet = 0;
+	rtl_p->eee.quiet = 0;
+	schedule_delayed_work(&rtl_p->load.work,
+			      msecs_to_jiffies(RTL_LOAD_SAMPLE_MS));
 }
 
-static void rtl_hw_start_8168cp_3(struct rtl8169_private *rtl_p)
+/* Must be called with RTNL held. The chip state is left to the caller. */
+static void rtl_load_policy_stop(struct rtl8169_private *rtl_p)
 {
-	rtl_set_def_aspm_entry_latency(rtl_p);
-
-	RTL_W8(rtl_p, Config3, RTL_R8(rtl_p, Config3) & ~Beacon_en);
-
-	/* Magic. */
-	RTL_W8(rtl_p, DBG_REG, 0x20);
+	cancel_delayed_work_sync(&rtl_p->load.work);
 }
 
-static void rtl_hw_start_8168c_1(struct rtl8169_private *rtl_p)
+/* Must be called with RTNL held after a policy was switched on or off */
+static void rtl_load_policy_update(struct rtl8169_private *rtl_p)
 {
-	static const struct ephy_info e_info_8168c_1[] = {
-		{ 0x02, 0x0800,	0x1000 },
-		{ 0x03, 0,	0x0002 },
-		{ 0x06, 0x0080,	0x0000 }
-	};
-
-	rtl_set_def_aspm_entry_latency(rtl_p);
+	if (!test_bit(RTL_FLAG_TASK_ENABLED, rtl_p->wk.flags))
+		return;
 
-	RTL_W8(rtl_p, DBG_REG, 0x06 | FIX_NAK_1 | FIX_NAK_2);
+	rtl_load_policy_stop(rtl_p);
+	if (!rtl_p->aspm.dynamic && rtl_p->aspm.busy != rtl_p->aspm.off)
+		rtl_aspm_set_busy(rtl_p, rtl_p->aspm.off);
+	if (!(rtl_p->priv_flags & RTL_PRIV_FLAG_EEE_ADAPTIVE) && rtl_p->eee.busy)
+		rtl_eee_set_busy(rtl_p, false);
+	rtl_load_policy_start(rtl_p);
+}
+
+struct rtl_profile_cfg {
+	const char *name;
+	u32 rx_usecs;
+	u32 rx_frames;
+	u32 tx_usecs;
+	u32 tx_frames;
+	/* software interrupt coalescing, see napi_complete_done() */
+	int defer_hard_irqs;
+	unsigned long gro_flush_ns;
+	bool aspm_off;
+	bool aspm_dynamic;
+	bool tx_lpi;
+	bool eee_adaptive;
+};
+
+static const struct rtl_profile_cfg rtl_profiles[RTL_PROFILE_MAX] = {
+	/* what probe sets up */
+	[RTL_PROFILE_DEFAULT] = {
+		.name = "default",
+		.defer_hard_irqs = 1,
+		.gro_flush_ns = 20000,
+		.tx_lpi = true,
+	},
+	/* interrupt per packet, no link power saving, busy-poll friendly */
+	[RTL_PROFILE_LATENCY] = {
+		.name = "latency",
+		.aspm_off = true,
+	},
+	[RTL_PROFILE_THROUGHPUT] = {
+		.name = "throughput",
+		.rx_usecs = 100,
+		.rx_frames = 32,
+		.tx_usecs = 100,
+		.tx_frames = 32,
+		.defer_hard_irqs = 2,
+		.gro_flush_ns = 50000,
+		.aspm_dynamic = true,
+		.tx_lpi = true,
+		.eee_adaptive = true,
+	},
+	[RTL_PROFILE_POWER] = {
+		.name = "power",
+		.rx_usecs = 50,
+		.rx_frames = 16,
+		.tx_usecs = 50,
+		.tx_frames = 16,
+		.defer_hard_irqs = 1,
+		.gro_flush_ns = 20000,
+		.tx_lpi = true,
+	},
+};
+
+/*
+ * Must be called with RTNL held. Everything is switched at once without
+ * bringing the interface down; the chip part is applied right away if the
+ * interface is up and by the next rtl_hw_start() otherwise. The hardware
+ * interrupt coalescing needs the link speed and is (re)applied on link up.
+ */
+static void rtl_set_profile(struct rtl8169_private *rtl_p,
+			    enum rtl_profile profile)
+{
+	const struct rtl_profile_cfg *cfg = &rtl_profiles[profile];
+	struct net_device *netdev = rtl_p->netdev;
+
+	WRITE_ONCE(netdev->napi_defer_hard_irqs, cfg->defer_hard_irqs);
+	WRITE_ONCE(netdev->gro_flush_timeout, cfg->gro_flush_ns);
+
+	rtl_p->aspm.off = cfg->aspm_off;
+	rtl_p->aspm.dynamic = cfg->aspm_dynamic &&
+			      rtl_aspm_dynamic_supported(rtl_p);
+
+	if (rtl_supports_eee(rtl_p)) {
+		rtl_p->eee.tx_lpi = cfg->tx_lpi;
+		if (cfg->eee_adaptive)
+			rtl_p->priv_flags |= RTL_PRIV_FLAG_EEE_ADAPTIVE;
+		else
+			rtl_p->priv_flags &= ~RTL_PRIV_FLAG_EEE_ADAPTIVE;
+	}
+
+	rtl_p->profile = profile;
+
+	if (!rtl_is_8125(rtl_p)) {
+		memset(&rtl_p->coal, 0, sizeof(rtl_p->coal));
+		rtl_p->coal.rx_coalesce_usecs = cfg->rx_usecs;
+		rtl_p->coal.rx_max_coalesced_frames = cfg->rx_frames;
+		rtl_p->coal.tx_coalesce_usecs = cfg->tx_usecs;
+		rtl_p->coal.tx_max_coalesced_frames = cfg->tx_frames;
+		rtl_p->coal_set = true;
+	}
+
+	if (!test_bit(RTL_FLAG_TASK_ENABLED, rtl_p->wk.flags))
+		return;
+
+	if (rtl_supports_eee(rtl_p))
+		rtl_eee_mac_lpi(rtl_p, rtl_eee_lpi_wanted(rtl_p));
+	rtl_load_policy_update(rtl_p);
+
+	if (rtl_p->coal_set && __rtl_set_coalesce(rtl_p, &rtl_p->coal))
+		netdev_info(netdev, "interrupt coalescing of profile %s not applied\n",
+			    cfg->name);
+}
+
+/* static FIFO sizes of all chips calling rtl_set_fifo_size() add up to this */
+#define RTL_FIFO_TOTAL		0x20
+
+static bool rtl_fifo_size_supported(struct rtl8169_private *rtl_p)
+{
+	/* RTL8402 only uses the dynamic FIFO */
+	return rtl_p->mac_version >= RTL_GIGA_MAC_VER_34 &&
+	       rtl_p->mac_version <= RTL_GIGA_MAC_VER_53 &&
+	       rtl_p->mac_version != RTL_GIGA_MAC_VER_37 &&
+	       rtl_p->mac_version != RTL_GIGA_MAC_VER_39;
+}
+
+static bool rtl_pause_thresholds_supported(struct rtl8169_private *rtl_p)
+{
+	return rtl_p->mac_version >= RTL_GIGA_MAC_VER_40 &&
+	       rtl_p->mac_version <= RTL_GIGA_MAC_VER_53;
+}
+
+/* static FIFO sizes and pause thresholds the chip specific init uses */
+static void rtl_fifo_init_defaults(struct rtl8169_private *rtl_p)
+{
+	switch (rtl_p->mac_version) {
+	case RTL_GIGA_MAC_VER_34 ... RTL_GIGA_MAC_VER_36:
+	case RTL_GIGA_MAC_VER_38:
+		rtl_p->fifo.rx_def = 0x10;
+		rtl_p->fifo.tx_def = 0x10;
+		break;
+	case RTL_GIGA_MAC_VER_40 ... RTL_GIGA_MAC_VER_48:
+		rtl_p->fifo.rx_def = 0x08;
+		rtl_p->fifo.tx_def = 0x10;
+		rtl_p->fifo.pause_low_def = 0x38;
+		rtl_p->fifo.pause_high_def = 0x48;
+		break;
+	case RTL_GIGA_MAC_VER_51 ... RTL_GIGA_MAC_VER_53:
+		rtl_p->fifo.rx_def = 0x08;
+		rtl_p->fifo.tx_def = 0x10;
+		rtl_p->fifo.pause_low_def = 0x2f;
+		rtl_p->fifo.pause_high_def = 0x5f;
+		break;
+	default:
+		break;
+	}
+}
+
+static void rtl_set_fifo_size(struct rtl8169_private *rtl_p, u16 rx_dyn,
+			      u16 tx_dyn)
+{
+	u16 rx_stat = rtl_p->fifo.rx_user ?: rtl_p->fifo.rx_def;
+	u16 tx_stat = rtl_p->fifo.tx_user ?: rtl_p->fifo.tx_def;
+
+	/* Usage of dynamic vs. static FIFO is controlled by bit
+	 * TXCFG_AUTO_FIFO. Exact meaning of FIFO values isn't known.
+	 */
+	rtl_eri_write(rtl_p, 0xc8, ERIAR_MASK_1111, (rx_stat << 16) | rx_dyn);
+	rtl_eri_write(rtl_p, 0xe8, ERIAR_MASK_1111, (tx_stat << 16) | tx_dyn);
+}
+
+static void rtl8168g_set_pause_thresholds(struct rtl8169_private *rtl_p)
+{
+	u8 low = rtl_p->fifo.pause_low_user ?: rtl_p->fifo.pause_low_def;
+	u8 high = rtl_p->fifo.pause_high_user ?: rtl_p->fifo.pause_high_def;
+
+	/* FIFO thresholds for pause flow control */
+	rtl_eri_write(rtl_p, 0xcc, ERIAR_MASK_0001, low);
+	rtl_eri_write(rtl_p, 0xd0, ERIAR_MASK_0001, high);
+}
+
+static void rtl_hw_start_8168b(struct rtl8169_private *rtl_p)
+{
+	RTL_W8(rtl_p, Config3, RTL_R8(rtl_p, Config3) & ~Beacon_en);
+}
+
+static void __rtl_hw_start_8168cp(struct rtl8169_private *rtl_p)
+{
+	RTL_W8(rtl_p, Config1, RTL_R8(rtl_p, Config1) | Speed_down);
+
+	RTL_W8(rtl_p, Config3, RTL_R8(rtl_p, Config3) & ~Beacon_en);
+
+	rtl_disable_clock_request(rtl_p);
+}
+
+static void rtl_hw_start_8168cp_1(struct rtl8169_private *rtl_p)
+{
+	static const struct ephy_info e_info_8168cp[] = {
+		{ 0x01, 0,	0x0001 },
+		{ 0x02, 0x0800,	0x1000 },
+		{ 0x03, 0,	0x0042 },
+		{ 0x06, 0x0080,	0x0000 },
+		{ 0x07, 0,	0x2000 }
+	};
+
+	rtl_set_def_aspm_entry_latency(rtl_p);
+
+	rtl_ephy_init(rtl_p, e_info_8168cp);
+
+	__rtl_hw_start_8168cp(rtl_p);
+}
+
+static void rtl_hw_start_8168cp_2(struct rtl8169_private *rtl_p)
+{
+	rtl_set_def_aspm_entry_latency(rtl_p);
+
+	RTL_W8(rtl_p, Config3, RTL_R8(rtl_p, Config3) & ~Beacon_en);
+}
+
+static void rtl_hw_start_8168cp_3(struct rtl8169_private *rtl_p)
+{
+	rtl_set_def_aspm_entry_latency(rtl_p);
+
+	RTL_W8(rtl_p, Config3, RTL_R8(rtl_p, Config3) & ~Beacon_en);
+
+	/* Magic. */
+	RTL_W8(rtl_p, DBG_REG, 0x20);
+}
+
+static void rtl_hw_start_8168c_1(struct rtl8169_private *rtl_p)
+{
+	static const struct ephy_info e_info_8168c_1[] = {
+		{ 0x02, 0x0800,	0x1000 },
+		{ 0x03, 0,	0x0002 },
+		{ 0x06, 0x0080,	0x0000 }
+	};
+
+	rtl_set_def_aspm_entry_latency(rtl_p);
+
+	RTL_W8(rtl_p, DBG_REG, 0x06 | FIX_NAK_1 | FIX_NAK_2);
 
 	rtl_ephy_init(rtl_p, e_info_8168c_1);
 
@@ -2914,25 +4450,25 @@ static void rtl_hw_start_8168d_4(struct rtl8169_private *rtl_p)
 
 static void rtl_hw_start_8168e_1(struct rtl8169_private *rtl_p)
 {
-	static const struct ephy_info e_info_8168e_1[] = {
-		{ 0x00, 0x0200,	0x0100 },
-		{ 0x00, 0x0000,	0x0004 },
-		{ 0x06, 0x0002,	0x0001 },
-		{ 0x06, 0x0000,	0x0030 },
-		{ 0x07, 0x0000,	0x2000 },
-		{ 0x00, 0x0000,	0x0020 },
-		{ 0x03, 0x5800,	0x2000 },
-		{ 0x03, 0x0000,	0x0001 },
-		{ 0x01, 0x0800,	0x1000 },
-		{ 0x07, 0x0000,	0x4000 },
-		{ 0x1e, 0x0000,	0x2000 },
-		{ 0x19, 0xffff,	0xfe6c },
-		{ 0x0a, 0x0000,	0x0040 }
+	static const struct rtl_script_cmd s_8168e_1_ephy[] = {
+		RTL_SCR_M(RTL_EPHY, 0x00, 0x0200, 0x0100),
+		RTL_SCR_M(RTL_EPHY, 0x00, 0x0000, 0x0004),
+		RTL_SCR_M(RTL_EPHY, 0x06, 0x0002, 0x0001),
+		RTL_SCR_M(RTL_EPHY, 0x06, 0x0000, 0x0030),
+		RTL_SCR_M(RTL_EPHY, 0x07, 0x0000, 0x2000),
+		RTL_SCR_M(RTL_EPHY, 0x00, 0x0000, 0x0020),
+		RTL_SCR_M(RTL_EPHY, 0x03, 0x5800, 0x2000),
+		RTL_SCR_M(RTL_EPHY, 0x03, 0x0000, 0x0001),
+		RTL_SCR_M(RTL_EPHY, 0x01, 0x0800, 0x1000),
+		RTL_SCR_M(RTL_EPHY, 0x07, 0x0000, 0x4000),
+		RTL_SCR_M(RTL_EPHY, 0x1e, 0x0000, 0x2000),
+		RTL_SCR_W(RTL_EPHY, 0x19, 0xfe6c),
+		RTL_SCR_M(RTL_EPHY, 0x0a, 0x0000, 0x0040),
 	};
 
 	rtl_set_def_aspm_entry_latency(rtl_p);
 
-	rtl_ephy_init(rtl_p, e_info_8168e_1);
+	rtl_run_script(rtl_p, s_8168e_1_ephy);
 
 	rtl_disable_clock_request(rtl_p);
 
@@ -2958,7 +4494,7 @@ static void rtl_hw_start_8168e_2(struct rtl8169_private *rtl_p)
 
 	rtl_eri_write(rtl_p, 0xc0, ERIAR_MASK_0011, 0x0000);
 	rtl_eri_write(rtl_p, 0xb8, ERIAR_MASK_1111, 0x0000);
-	rtl_set_fifo_size(rtl_p, 0x10, 0x10, 0x02, 0x06);
+	rtl_set_fifo_size(rtl_p, 0x02, 0x06);
 	rtl_eri_set_bits(rtl_p, 0x1d0, BIT(1));
 	rtl_reset_packet_filter(rtl_p);
 	rtl_eri_set_bits(rtl_p, 0x1b0, BIT(4));
@@ -2982,7 +4518,7 @@ static void rtl_hw_start_8168f(struct rtl8169_private *rtl_p)
 
 	rtl_eri_write(rtl_p, 0xc0, ERIAR_MASK_0011, 0x0000);
 	rtl_eri_write(rtl_p, 0xb8, ERIAR_MASK_1111, 0x0000);
-	rtl_set_fifo_size(rtl_p, 0x10, 0x10, 0x02, 0x06);
+	rtl_set_fifo_size(rtl_p, 0x02, 0x06);
 	rtl_reset_packet_filter(rtl_p);
 	rtl_eri_set_bits(rtl_p, 0x1b0, BIT(4));
 	rtl_eri_set_bits(rtl_p, 0x1d0, BIT(4) | BIT(1));
@@ -3033,8 +4569,8 @@ static void rtl_hw_start_8411(struct rtl8169_private *rtl_p)
 
 static void rtl_hw_start_8168g(struct rtl8169_private *rtl_p)
 {
-	rtl_set_fifo_size(rtl_p, 0x08, 0x10, 0x02, 0x06);
-	rtl8168g_set_pause_thresholds(rtl_p, 0x38, 0x48);
+	rtl_set_fifo_size(rtl_p, 0x02, 0x06);
+	rtl8168g_set_pause_thresholds(rtl_p);
 
 	rtl_set_def_aspm_entry_latency(rtl_p);
 
@@ -3099,6 +4635,140 @@ static void rtl_hw_start_8411_2(struct rtl8169_private *rtl_p)
 		{ 0x04, 0x0000,	0x0010 },
 		{ 0x1d, 0x0000,	0x4000 },
 	};
+	static const struct rtl_script_cmd s_8411_2_mac_patch[] = {
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC28, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC2A, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC2C, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC2E, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC30, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC32, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC34, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC36, 0x0000),
+		RTL_SCR_UDELAY(3000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC26, 0x0000),
+
+		RTL_SCR_W(RTL_MAC_OCP, 0xF800, 0xE008),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF802, 0xE00A),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF804, 0xE00C),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF806, 0xE00E),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF808, 0xE027),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF80A, 0xE04F),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF80C, 0xE05E),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF80E, 0xE065),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF810, 0xC602),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF812, 0xBE00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF814, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF816, 0xC502),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF818, 0xBD00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF81A, 0x074C),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF81C, 0xC302),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF81E, 0xBB00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF820, 0x080A),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF822, 0x6420),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF824, 0x48C2),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF826, 0x8C20),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF828, 0xC516),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF82A, 0x64A4),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF82C, 0x49C0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF82E, 0xF009),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF830, 0x74A2),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF832, 0x8CA5),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF834, 0x74A0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF836, 0xC50E),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF838, 0x9CA2),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF83A, 0x1C11),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF83C, 0x9CA0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF83E, 0xE006),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF840, 0x74F8),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF842, 0x48C4),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF844, 0x8CF8),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF846, 0xC404),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF848, 0xBC00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF84A, 0xC403),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF84C, 0xBC00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF84E, 0x0BF2),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF850, 0x0C0A),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF852, 0xE434),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF854, 0xD3C0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF856, 0x49D9),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF858, 0xF01F),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF85A, 0xC526),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF85C, 0x64A5),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF85E, 0x1400),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF860, 0xF007),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF862, 0x0C01),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF864, 0x8CA5),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF866, 0x1C15),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF868, 0xC51B),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF86A, 0x9CA0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF86C, 0xE013),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF86E, 0xC519),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF870, 0x74A0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF872, 0x48C4),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF874, 0x8CA0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF876, 0xC516),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF878, 0x74A4),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF87A, 0x48C8),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF87C, 0x48CA),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF87E, 0x9CA4),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF880, 0xC512),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF882, 0x1B00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF884, 0x9BA0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF886, 0x1B1C),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF888, 0x483F),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF88A, 0x9BA2),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF88C, 0x1B04),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF88E, 0xC508),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF890, 0x9BA0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF892, 0xC505),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF894, 0xBD00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF896, 0xC502),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF898, 0xBD00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF89A, 0x0300),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF89C, 0x051E),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF89E, 0xE434),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8A0, 0xE018),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8A2, 0xE092),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8A4, 0xDE20),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8A6, 0xD3C0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8A8, 0xC50F),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8AA, 0x76A4),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8AC, 0x49E3),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8AE, 0xF007),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8B0, 0x49C0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8B2, 0xF103),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8B4, 0xC607),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8B6, 0xBE00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8B8, 0xC606),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8BA, 0xBE00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8BC, 0xC602),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8BE, 0xBE00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8C0, 0x0C4C),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8C2, 0x0C28),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8C4, 0x0C2C),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8C6, 0xDC00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8C8, 0xC707),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8CA, 0x1D00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8CC, 0x8DE2),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8CE, 0x48C1),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8D0, 0xC502),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8D2, 0xBD00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8D4, 0x00AA),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8D6, 0xE0C0),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8D8, 0xC502),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8DA, 0xBD00),
+		RTL_SCR_W(RTL_MAC_OCP, 0xF8DC, 0x0132),
+
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC26, 0x8000),
+
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC2A, 0x0743),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC2C, 0x0801),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC2E, 0x0BE9),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC30, 0x02FD),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC32, 0x0C25),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC34, 0x00A9),
+		RTL_SCR_W(RTL_MAC_OCP, 0xFC36, 0x012D),
+	};
 
 	rtl_hw_start_8168g(rtl_p);
 
@@ -3107,140 +4777,16 @@ static void rtl_hw_start_8411_2(struct rtl8169_private *rtl_p)
 	/* The following Realtek-provided magic fixes an issue with the RX unit
 	 * getting confused after the PHY having been powered-down.
 	 */
-	r8168_mac_ocp_write(rtl_p, 0xFC28, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xFC2A, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xFC2C, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xFC2E, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xFC30, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xFC32, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xFC34, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xFC36, 0x0000);
-	mdelay(3);
-	r8168_mac_ocp_write(rtl_p, 0xFC26, 0x0000);
-
-	r8168_mac_ocp_write(rtl_p, 0xF800, 0xE008);
-	r8168_mac_ocp_write(rtl_p, 0xF802, 0xE00A);
-	r8168_mac_ocp_write(rtl_p, 0xF804, 0xE00C);
-	r8168_mac_ocp_write(rtl_p, 0xF806, 0xE00E);
-	r8168_mac_ocp_write(rtl_p, 0xF808, 0xE027);
-	r8168_mac_ocp_write(rtl_p, 0xF80A, 0xE04F);
-	r8168_mac_ocp_write(rtl_p, 0xF80C, 0xE05E);
-	r8168_mac_ocp_write(rtl_p, 0xF80E, 0xE065);
-	r8168_mac_ocp_write(rtl_p, 0xF810, 0xC602);
-	r8168_mac_ocp_write(rtl_p, 0xF812, 0xBE00);
-	r8168_mac_ocp_write(rtl_p, 0xF814, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xF816, 0xC502);
-	r8168_mac_ocp_write(rtl_p, 0xF818, 0xBD00);
-	r8168_mac_ocp_write(rtl_p, 0xF81A, 0x074C);
-	r8168_mac_ocp_write(rtl_p, 0xF81C, 0xC302);
-	r8168_mac_ocp_write(rtl_p, 0xF81E, 0xBB00);
-	r8168_mac_ocp_write(rtl_p, 0xF820, 0x080A);
-	r8168_mac_ocp_write(rtl_p, 0xF822, 0x6420);
-	r8168_mac_ocp_write(rtl_p, 0xF824, 0x48C2);
-	r8168_mac_ocp_write(rtl_p, 0xF826, 0x8C20);
-	r8168_mac_ocp_write(rtl_p, 0xF828, 0xC516);
-	r8168_mac_ocp_write(rtl_p, 0xF82A, 0x64A4);
-	r8168_mac_ocp_write(rtl_p, 0xF82C, 0x49C0);
-	r8168_mac_ocp_write(rtl_p, 0xF82E, 0xF009);
-	r8168_mac_ocp_write(rtl_p, 0xF830, 0x74A2);
-	r8168_mac_ocp_write(rtl_p, 0xF832, 0x8CA5);
-	r8168_mac_ocp_write(rtl_p, 0xF834, 0x74A0);
-	r8168_mac_ocp_write(rtl_p, 0xF836, 0xC50E);
-	r8168_mac_ocp_write(rtl_p, 0xF838, 0x9CA2);
-	r8168_mac_ocp_write(rtl_p, 0xF83A, 0x1C11);
-	r8168_mac_ocp_write(rtl_p, 0xF83C, 0x9CA0);
-	r8168_mac_ocp_write(rtl_p, 0xF83E, 0xE006);
-	r8168_mac_ocp_write(rtl_p, 0xF840, 0x74F8);
-	r8168_mac_ocp_write(rtl_p, 0xF842, 0x48C4);
-	r8168_mac_ocp_write(rtl_p, 0xF844, 0x8CF8);
-	r8168_mac_ocp_write(rtl_p, 0xF846, 0xC404);
-	r8168_mac_ocp_write(rtl_p, 0xF848, 0xBC00);
-	r8168_mac_ocp_write(rtl_p, 0xF84A, 0xC403);
-	r8168_mac_ocp_write(rtl_p, 0xF84C, 0xBC00);
-	r8168_mac_ocp_write(rtl_p, 0xF84E, 0x0BF2);
-	r8168_mac_ocp_write(rtl_p, 0xF850, 0x0C0A);
-	r8168_mac_ocp_write(rtl_p, 0xF852, 0xE434);
-	r8168_mac_ocp_write(rtl_p, 0xF854, 0xD3C0);
-	r8168_mac_ocp_write(rtl_p, 0xF856, 0x49D9);
-	r8168_mac_ocp_write(rtl_p, 0xF858, 0xF01F);
-	r8168_mac_ocp_write(rtl_p, 0xF85A, 0xC526);
-	r8168_mac_ocp_write(rtl_p, 0xF85C, 0x64A5);
-	r8168_mac_ocp_write(rtl_p, 0xF85E, 0x1400);
-	r8168_mac_ocp_write(rtl_p, 0xF860, 0xF007);
-	r8168_mac_ocp_write(rtl_p, 0xF862, 0x0C01);
-	r8168_mac_ocp_write(rtl_p, 0xF864, 0x8CA5);
-	r8168_mac_ocp_write(rtl_p, 0xF866, 0x1C15);
-	r8168_mac_ocp_write(rtl_p, 0xF868, 0xC51B);
-	r8168_mac_ocp_write(rtl_p, 0xF86A, 0x9CA0);
-	r8168_mac_ocp_write(rtl_p, 0xF86C, 0xE013);
-	r8168_mac_ocp_write(rtl_p, 0xF86E, 0xC519);
-	r8168_mac_ocp_write(rtl_p, 0xF870, 0x74A0);
-	r8168_mac_ocp_write(rtl_p, 0xF872, 0x48C4);
-	r8168_mac_ocp_write(rtl_p, 0xF874, 0x8CA0);
-	r8168_mac_ocp_write(rtl_p, 0xF876, 0xC516);
-	r8168_mac_ocp_write(rtl_p, 0xF878, 0x74A4);
-	r8168_mac_ocp_write(rtl_p, 0xF87A, 0x48C8);
-	r8168_mac_ocp_write(rtl_p, 0xF87C, 0x48CA);
-	r8168_mac_ocp_write(rtl_p, 0xF87E, 0x9CA4);
-	r8168_mac_ocp_write(rtl_p, 0xF880, 0xC512);
-	r8168_mac_ocp_write(rtl_p, 0xF882, 0x1B00);
-	r8168_mac_ocp_write(rtl_p, 0xF884, 0x9BA0);
-	r8168_mac_ocp_write(rtl_p, 0xF886, 0x1B1C);
-	r8168_mac_ocp_write(rtl_p, 0xF888, 0x483F);
-	r8168_mac_ocp_write(rtl_p, 0xF88A, 0x9BA2);
-	r8168_mac_ocp_write(rtl_p, 0xF88C, 0x1B04);
-	r8168_mac_ocp_write(rtl_p, 0xF88E, 0xC508);
-	r8168_mac_ocp_write(rtl_p, 0xF890, 0x9BA0);
-	r8168_mac_ocp_write(rtl_p, 0xF892, 0xC505);
-	r8168_mac_ocp_write(rtl_p, 0xF894, 0xBD00);
-	r8168_mac_ocp_write(rtl_p, 0xF896, 0xC502);
-	r8168_mac_ocp_write(rtl_p, 0xF898, 0xBD00);
-	r8168_mac_ocp_write(rtl_p, 0xF89A, 0x0300);
-	r8168_mac_ocp_write(rtl_p, 0xF89C, 0x051E);
-	r8168_mac_ocp_write(rtl_p, 0xF89E, 0xE434);
-	r8168_mac_ocp_write(rtl_p, 0xF8A0, 0xE018);
-	r8168_mac_ocp_write(rtl_p, 0xF8A2, 0xE092);
-	r8168_mac_ocp_write(rtl_p, 0xF8A4, 0xDE20);
-	r8168_mac_ocp_write(rtl_p, 0xF8A6, 0xD3C0);
-	r8168_mac_ocp_write(rtl_p, 0xF8A8, 0xC50F);
-	r8168_mac_ocp_write(rtl_p, 0xF8AA, 0x76A4);
-	r8168_mac_ocp_write(rtl_p, 0xF8AC, 0x49E3);
-	r8168_mac_ocp_write(rtl_p, 0xF8AE, 0xF007);
-	r8168_mac_ocp_write(rtl_p, 0xF8B0, 0x49C0);
-	r8168_mac_ocp_write(rtl_p, 0xF8B2, 0xF103);
-	r8168_mac_ocp_write(rtl_p, 0xF8B4, 0xC607);
-	r8168_mac_ocp_write(rtl_p, 0xF8B6, 0xBE00);
-	r8168_mac_ocp_write(rtl_p, 0xF8B8, 0xC606);
-	r8168_mac_ocp_write(rtl_p, 0xF8BA, 0xBE00);
-	r8168_mac_ocp_write(rtl_p, 0xF8BC, 0xC602);
-	r8168_mac_ocp_write(rtl_p, 0xF8BE, 0xBE00);
-	r8168_mac_ocp_write(rtl_p, 0xF8C0, 0x0C4C);
-	r8168_mac_ocp_write(rtl_p, 0xF8C2, 0x0C28);
-	r8168_mac_ocp_write(rtl_p, 0xF8C4, 0x0C2C);
-	r8168_mac_ocp_write(rtl_p, 0xF8C6, 0xDC00);
-	r8168_mac_ocp_write(rtl_p, 0xF8C8, 0xC707);
-	r8168_mac_ocp_write(rtl_p, 0xF8CA, 0x1D00);
-	r8168_mac_ocp_write(rtl_p, 0xF8CC, 0x8DE2);
-	r8168_mac_ocp_write(rtl_p, 0xF8CE, 0x48C1);
-	r8168_mac_ocp_write(rtl_p, 0xF8D0, 0xC502);
-	r8168_mac_ocp_write(rtl_p, 0xF8D2, 0xBD00);
-	r8168_mac_ocp_write(rtl_p, 0xF8D4, 0x00AA);
-	r8168_mac_ocp_write(rtl_p, 0xF8D6, 0xE0C0);
-	r8168_mac_ocp_write(rtl_p, 0xF8D8, 0xC502);
-	r8168_mac_ocp_write(rtl_p, 0xF8DA, 0xBD00);
-	r8168_mac_ocp_write(rtl_p, 0xF8DC, 0x0132);
-
-	r8168_mac_ocp_write(rtl_p, 0xFC26, 0x8000);
-
-	r8168_mac_ocp_write(rtl_p, 0xFC2A, 0x0743);
-	r8168_mac_ocp_write(rtl_p, 0xFC2C, 0x0801);
-	r8168_mac_ocp_write(rtl_p, 0xFC2E, 0x0BE9);
-	r8168_mac_ocp_write(rtl_p, 0xFC30, 0x02FD);
-	r8168_mac_ocp_write(rtl_p, 0xFC32, 0x0C25);
-	r8168_mac_ocp_write(rtl_p, 0xFC34, 0x00A9);
-	r8168_mac_ocp_write(rtl_p, 0xFC36, 0x012D);
+	rtl_run_script(rtl_p, s_8411_2_mac_patch);
 }
 
+static const struct rtl_script_cmd s_8168h_pfm_off[] = {
+	RTL_SCR_M(RTL_MMIO8, DLLPR, PFM_EN, 0),
+	RTL_SCR_M(RTL_MMIO8, MISC_1, PFM_D3COLD_EN, 0),
+
+	RTL_SCR_M(RTL_MMIO8, DLLPR, TX_10M_PS_EN, 0),
+};
+
 static void rtl_hw_start_8168h_1(struct rtl8169_private *rtl_p)
 {
 	static const struct ephy_info e_info_8168h_1[] = {
@@ -3251,12 +4797,23 @@ static void rtl_hw_start_8168h_1(struct rtl8169_private *rtl_p)
 		{ 0x04, 0xffff,	0x854a },
 		{ 0x01, 0xffff,	0x068b }
 	};
+	static const struct rtl_script_cmd s_8168h_1_mac[] = {
+		RTL_SCR_M(RTL_MAC_OCP, 0xe056, 0x00f0, 0x0070),
+		RTL_SCR_M(RTL_MAC_OCP, 0xe052, 0x6000, 0x8008),
+		RTL_SCR_M(RTL_MAC_OCP, 0xe0d6, 0x01ff, 0x017f),
+		RTL_SCR_M(RTL_MAC_OCP, 0xd420, 0x0fff, 0x047f),
+
+		RTL_SCR_W(RTL_MAC_OCP, 0xe63e, 0x0001),
+		RTL_SCR_W(RTL_MAC_OCP, 0xe63e, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xc094, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xc09e, 0x0000),
+	};
 	int rg_saw_cnt;
 
 	rtl_ephy_init(rtl_p, e_info_8168h_1);
 
-	rtl_set_fifo_size(rtl_p, 0x08, 0x10, 0x02, 0x06);
-	rtl8168g_set_pause_thresholds(rtl_p, 0x38, 0x48);
+	rtl_set_fifo_size(rtl_p, 0x02, 0x06);
+	rtl8168g_set_pause_thresholds(rtl_p);
 
 	rtl_set_def_aspm_entry_latency(rtl_p);
 
@@ -3273,10 +4830,7 @@ static void rtl_hw_start_8168h_1(struct rtl8169_private *rtl_p)
 
 	rtl8168_config_eee_mac(rtl_p);
 
-	RTL_W8(rtl_p, DLLPR, RTL_R8(rtl_p, DLLPR) & ~PFM_EN);
-	RTL_W8(rtl_p, MISC_1, RTL_R8(rtl_p, MISC_1) & ~PFM_D3COLD_EN);
-
-	RTL_W8(rtl_p, DLLPR, RTL_R8(rtl_p, DLLPR) & ~TX_10M_PS_EN);
+	rtl_run_script(rtl_p, s_8168h_pfm_off);
 
 	rtl_eri_clear_bits(rtl_p, 0x1b0, BIT(12));
 
@@ -3291,23 +4845,15 @@ static void rtl_hw_start_8168h_1(struct rtl8169_private *rtl_p)
 		r8168_mac_ocp_modify(rtl_p, 0xd412, 0x0fff, sw_cnt_1ms_ini);
 	}
 
-	r8168_mac_ocp_modify(rtl_p, 0xe056, 0x00f0, 0x0070);
-	r8168_mac_ocp_modify(rtl_p, 0xe052, 0x6000, 0x8008);
-	r8168_mac_ocp_modify(rtl_p, 0xe0d6, 0x01ff, 0x017f);
-	r8168_mac_ocp_modify(rtl_p, 0xd420, 0x0fff, 0x047f);
-
-	r8168_mac_ocp_write(rtl_p, 0xe63e, 0x0001);
-	r8168_mac_ocp_write(rtl_p, 0xe63e, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xc094, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xc09e, 0x0000);
+	rtl_run_script(rtl_p, s_8168h_1_mac);
 }
 
 static void rtl_hw_start_8168ep(struct rtl8169_private *rtl_p)
 {
 	rtl8168ep_stop_cmac(rtl_p);
 
-	rtl_set_fifo_size(rtl_p, 0x08, 0x10, 0x02, 0x06);
-	rtl8168g_set_pause_thresholds(rtl_p, 0x2f, 0x5f);
+	rtl_set_fifo_size(rtl_p, 0x02, 0x06);
+	rtl8168g_set_pause_thresholds(rtl_p);
 
 	rtl_set_def_aspm_entry_latency(rtl_p);
 
@@ -3337,17 +4883,20 @@ static void rtl_hw_start_8168ep_3(struct rtl8169_private *rtl_p)
 		{ 0x19, 0x8021,	0x0000 },
 		{ 0x1e, 0x0000,	0x2000 },
 	};
+	static const struct rtl_script_cmd s_8168ep_3[] = {
+		RTL_SCR_M(RTL_MMIO8, DLLPR, PFM_EN, 0),
+		RTL_SCR_M(RTL_MMIO8, MISC_1, PFM_D3COLD_EN, 0),
+
+		RTL_SCR_M(RTL_MAC_OCP, 0xd3e2, 0x0fff, 0x0271),
+		RTL_SCR_M(RTL_MAC_OCP, 0xd3e4, 0x00ff, 0x0000),
+		RTL_SCR_M(RTL_MAC_OCP, 0xe860, 0x0000, 0x0080),
+	};
 
 	rtl_ephy_init(rtl_p, e_info_8168ep_3);
 
 	rtl_hw_start_8168ep(rtl_p);
 
-	RTL_W8(rtl_p, DLLPR, RTL_R8(rtl_p, DLLPR) & ~PFM_EN);
-	RTL_W8(rtl_p, MISC_1, RTL_R8(rtl_p, MISC_1) & ~PFM_D3COLD_EN);
-
-	r8168_mac_ocp_modify(rtl_p, 0xd3e2, 0x0fff, 0x0271);
-	r8168_mac_ocp_modify(rtl_p, 0xd3e4, 0x00ff, 0x0000);
-	r8168_mac_ocp_modify(rtl_p, 0xe860, 0x0000, 0x0080);
+	rtl_run_script(rtl_p, s_8168ep_3);
 }
 
 static void rtl_hw_start_8117(struct rtl8169_private *rtl_p)
@@ -3356,13 +4905,24 @@ static void rtl_hw_start_8117(struct rtl8169_private *rtl_p)
 		{ 0x19, 0x0040,	0x1100 },
 		{ 0x59, 0x0040,	0x1100 },
 	};
+	static const struct rtl_script_cmd s_8117_mac[] = {
+		RTL_SCR_M(RTL_MAC_OCP, 0xe056, 0x00f0, 0x0070),
+		RTL_SCR_W(RTL_MAC_OCP, 0xea80, 0x0003),
+		RTL_SCR_M(RTL_MAC_OCP, 0xe052, 0x0000, 0x0009),
+		RTL_SCR_M(RTL_MAC_OCP, 0xd420, 0x0fff, 0x047f),
+
+		RTL_SCR_W(RTL_MAC_OCP, 0xe63e, 0x0001),
+		RTL_SCR_W(RTL_MAC_OCP, 0xe63e, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xc094, 0x0000),
+		RTL_SCR_W(RTL_MAC_OCP, 0xc09e, 0x0000),
+	};
 	int rg_saw_cnt;
 
 	rtl8168ep_stop_cmac(rtl_p);
 	rtl_ephy_init(rtl_p, e_info_8117);
 
-	rtl_set_fifo_size(rtl_p, 0x08, 0x10, 0x02, 0x06);
-	rtl8168g_set_pause_thresholds(rtl_p, 0x2f, 0x5f);
+	rtl_set_fifo_size(rtl_p, 0x02, 0x06);
+	rtl8168g_set_pause_thresholds(rtl_p);
 
 	rtl_set_def_aspm_entry_latency(rtl_p);
 
@@ -3379,10 +4939,7 @@ static void rtl_hw_start_8117(struct rtl8169_private *rtl_p)
 
 	rtl8168_config_eee_mac(rtl_p);
 
-	RTL_W8(rtl_p, DLLPR, RTL_R8(rtl_p, DLLPR) & ~PFM_EN);
-	RTL_W8(rtl_p, MISC_1, RTL_R8(rtl_p, MISC_1) & ~PFM_D3COLD_EN);
-
-	RTL_W8(rtl_p, DLLPR, RTL_R8(rtl_p, DLLPR) & ~TX_10M_PS_EN);
+	rtl_run_script(rtl_p, s_8168h_pfm_off);
 
 	rtl_eri_clear_bits(rtl_p, 0x1b0, BIT(12));
 
@@ -3396,15 +4953,7 @@ static void rtl_hw_start_8117(struct rtl8169_private *rtl_p)
 		r8168_mac_ocp_modify(rtl_p, 0xd412, 0x0fff, sw_cnt_1ms_ini);
 	}
 
-	r8168_mac_ocp_modify(rtl_p, 0xe056, 0x00f0, 0x0070);
-	r8168_mac_ocp_write(rtl_p, 0xea80, 0x0003);
-	r8168_mac_ocp_modify(rtl_p, 0xe052, 0x0000, 0x0009);
-	r8168_mac_ocp_modify(rtl_p, 0xd420, 0x0fff, 0x047f);
-
-	r8168_mac_ocp_write(rtl_p, 0xe63e, 0x0001);
-	r8168_mac_ocp_write(rtl_p, 0xe63e, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xc094, 0x0000);
-	r8168_mac_ocp_write(rtl_p, 0xc09e, 0x0000);
+	rtl_run_script(rtl_p, s_8117_mac);
 
 	/* firmware is for MAC only */
 	r8169_apply_firmware(rtl_p);
@@ -3469,27 +5018,26 @@ static void rtl_hw_start_8401(struct rtl8169_private *rtl_p)
 
 static void rtl_hw_start_8105e_1(struct rtl8169_private *rtl_p)
 {
-	static const struct ephy_info e_info_8105e_1[] = {
-		{ 0x07,	0, 0x4000 },
-		{ 0x19,	0, 0x0200 },
-		{ 0x19,	0, 0x0020 },
-		{ 0x1e,	0, 0x2000 },
-		{ 0x03,	0, 0x0001 },
-		{ 0x19,	0, 0x0100 },
-		{ 0x19,	0, 0x0004 },
-		{ 0x0a,	0, 0x0020 }
+	static const struct rtl_script_cmd s_8105e_1[] = {
+		/* Force LAN exit from ASPM if Rx/Tx are not idle */
+		RTL_SCR_M(RTL_MMIO32, FuncEvent, 0, 0x002800),
+		/* Disable Early Tally Counter */
+		RTL_SCR_M(RTL_MMIO32, FuncEvent, 0x010000, 0),
+
+		RTL_SCR_M(RTL_MMIO8, MCU, 0, EN_NDP | EN_OOB_RESET),
+		RTL_SCR_M(RTL_MMIO8, DLLPR, 0, PFM_EN),
+
+		RTL_SCR_M(RTL_EPHY, 0x07, 0, 0x4000),
+		RTL_SCR_M(RTL_EPHY, 0x19, 0, 0x0200),
+		RTL_SCR_M(RTL_EPHY, 0x19, 0, 0x0020),
+		RTL_SCR_M(RTL_EPHY, 0x1e, 0, 0x2000),
+		RTL_SCR_M(RTL_EPHY, 0x03, 0, 0x0001),
+		RTL_SCR_M(RTL_EPHY, 0x19, 0, 0x0100),
+		RTL_SCR_M(RTL_EPHY, 0x19, 0, 0x0004),
+		RTL_SCR_M(RTL_EPHY, 0x0a, 0, 0x0020),
 	};
 
-	/* Force LAN exit from ASPM if Rx/Tx are not idle */
-	RTL_W32(rtl_p, FuncEvent, RTL_R32(rtl_p, FuncEvent) | 0x002800);
-
-	/* Disable Early Tally Counter */
-	RTL_W32(rtl_p, FuncEvent, RTL_R32(rtl_p, FuncEvent) & ~0x010000);
-
-	RTL_W8(rtl_p, MCU, RTL_R8(rtl_p, MCU) | EN_NDP | EN_OOB_RESET);
-	RTL_W8(rtl_p, DLLPR, RTL_R8(rtl_p, DLLPR) | PFM_EN);
-
-	rtl_ephy_init(rtl_p, e_info_8105e_1);
+	rtl_run_script(rtl_p, s_8105e_1);
 
 	rtl_pcie_state_l2l3_disable(rtl_p);
 }
@@ -3516,7 +5064,7 @@ static void rtl_hw_start_8402(struct rtl8169_private *rtl_p)
 
 	rtl_ephy_init(rtl_p, e_info_8402);
 
-	rtl_set_fifo_size(rtl_p, 0x00, 0x00, 0x02, 0x06);
+	rtl_set_fifo_size(rtl_p, 0x02, 0x06);
 	rtl_reset_packet_filter(rtl_p);
 	rtl_eri_write(rtl_p, 0xc0, ERIAR_MASK_0011, 0x0000);
 	rtl_eri_write(rtl_p, 0xb8, ERIAR_MASK_0011, 0x0000);
@@ -3555,26 +5103,49 @@ DECLARE_RTL_COND(rtl_mac_ocp_e00e_cond)
 
 static void rtl_hw_start_8125_common(struct rtl8169_private *rtl_p)
 {
-	rtl_pcie_state_l2l3_disable(rtl_p);
+	static const struct rtl_script_cmd s_8125_1[] = {
+		RTL_SCR_W(RTL_MMIO16, 0x382, 0x221b),
+		RTL_SCR_W(RTL_MMIO8, 0x4500, 0),
+		RTL_SCR_W(RTL_MMIO16, 0x4800, 0),
 
-	RTL_W16(rtl_p, 0x382, 0x221b);
-	RTL_W8(rtl_p, 0x4500, 0);
-	RTL_W16(rtl_p, 0x4800, 0);
+		/* disable UPS */
+		RTL_SCR_M(RTL_MAC_OCP, 0xd40a, 0x0010, 0x0000),
 
-	/* disable UPS */
-	r8168_mac_ocp_modify(rtl_p, 0xd40a, 0x0010, 0x0000);
+		RTL_SCR_M(RTL_MMIO8, Config1, 0x10, 0),
 
-	RTL_W8(rtl_p, Config1, RTL_R8(rtl_p, Config1) & ~0x10);
+		RTL_SCR_W(RTL_MAC_OCP, 0xc140, 0xffff),
+		RTL_SCR_W(RTL_MAC_OCP, 0xc142, 0xffff),
 
-	r8168_mac_ocp_write(rtl_p, 0xc140, 0xffff);
-	r8168_mac_ocp_write(rtl_p, 0xc142, 0xffff);
+		RTL_SCR_M(RTL_MAC_OCP, 0xd3e2, 0x0fff, 0x03a9),
+		RTL_SCR_M(RTL_MAC_OCP, 0xd3e4, 0x00ff, 0x0000),
+		RTL_SCR_M(RTL_MAC_OCP, 0xe860, 0x0000, 0x0080),
+
+		/* disable new tx descriptor format */
+		RTL_SCR_M(RTL_MAC_OCP, 0xeb58, 0x0001, 0x0000),
+	};
+	static const struct rtl_script_cmd s_8125_2[] = {
+		RTL_SCR_M(RTL_MAC_OCP, 0xc0b4, 0x0000, 0x000c),
+		RTL_SCR_M(RTL_MAC_OCP, 0xeb6a, 0x00ff, 0x0033),
+		RTL_SCR_M(RTL_MAC_OCP, 0xeb50, 0x03e0, 0x0040),
+		RTL_SCR_M(RTL_MAC_OCP, 0xe056, 0x00f0, 0x0030),
+		RTL_SCR_M(RTL_MAC_OCP, 0xe040, 0x1000, 0x0000),
+		RTL_SCR_M(RTL_MAC_OCP, 0xea1c, 0x0003, 0x0001),
+		RTL_SCR_M(RTL_MAC_OCP, 0xe0c0, 0x4f0f, 0x4403),
+		RTL_SCR_M(RTL_MAC_OCP, 0xe052, 0x0080, 0x0068),
+		RTL_SCR_M(RTL_MAC_OCP, 0xd430, 0x0fff, 0x047f),
+
+		RTL_SCR_M(RTL_MAC_OCP, 0xea1c, 0x0004, 0x0000),
+		RTL_SCR_M(RTL_MAC_OCP, 0xeb54, 0x0000, 0x0001),
+		RTL_SCR_UDELAY(1),
+		RTL_SCR_M(RTL_MAC_OCP, 0xeb54, 0x0001, 0x0000),
+		RTL_SCR_M(RTL_MMIO16, 0x1880, 0x0030, 0),
+
+		RTL_SCR_W(RTL_MAC_OCP, 0xe098, 0xc302),
+	};
 
-	r8168_mac_ocp_modify(rtl_p, 0xd3e2, 0x0fff, 0x03a9);
-	r8168_mac_ocp_modify(rtl_p, 0xd3e4, 0x00ff, 0x0000);
-	r8168_mac_ocp_modify(rtl_p, 0xe860, 0x0000, 0x0080);
+	rtl_pcie_state_l2l3_disable(rtl_p);
 
-	/* disable new tx descriptor format */
-	r8168_mac_ocp_modify(rtl_p, 0xeb58, 0x0001, 0x0000);
+	rtl_run_script(rtl_p, s_8125_1);
 
 	if (rtl_p->mac_version == RTL_GIGA_MAC_VER_63)
 		r8168_mac_ocp_modify(rtl_p, 0xe614, 0x0700, 0x0200);
@@ -3586,23 +5157,7 @@ static void rtl_hw_start_8125_common(struct rtl8169_private *rtl_p)
 	else
 		r8168_mac_ocp_modify(rtl_p, 0xe63e, 0x0c30, 0x0020);
 
-	r8168_mac_ocp_modify(rtl_p, 0xc0b4, 0x0000, 0x000c);
-	r8168_mac_ocp_modify(rtl_p, 0xeb6a, 0x00ff, 0x0033);
-	r8168_mac_ocp_modify(rtl_p, 0xeb50, 0x03e0, 0x0040);
-	r8168_mac_ocp_modify(rtl_p, 0xe056, 0x00f0, 0x0030);
-	r8168_mac_ocp_modify(rtl_p, 0xe040, 0x1000, 0x0000);
-	r8168_mac_ocp_modify(rtl_p, 0xea1c, 0x0003, 0x0001);
-	r8168_mac_ocp_modify(rtl_p, 0xe0c0, 0x4f0f, 0x4403);
-	r8168_mac_ocp_modify(rtl_p, 0xe052, 0x0080, 0x0068);
-	r8168_mac_ocp_modify(rtl_p, 0xd430, 0x0fff, 0x047f);
-
-	r8168_mac_ocp_modify(rtl_p, 0xea1c, 0x0004, 0x0000);
-	r8168_mac_ocp_modify(rtl_p, 0xeb54, 0x0000, 0x0001);
-	udelay(1);
-	r8168_mac_ocp_modify(rtl_p, 0xeb54, 0x0001, 0x0000);
-	RTL_W16(rtl_p, 0x1880, RTL_R16(rtl_p, 0x1880) & ~0x0030);
-
-	r8168_mac_ocp_write(rtl_p, 0xe098, 0xc302);
+	rtl_run_script(rtl_p, s_8125_2);
 
 	rtl_loop_wait_low(rtl_p, &rtl_mac_ocp_e00e_cond, 1000, 10);
 
@@ -3745,6 +5300,11 @@ static void rtl_hw_start_8169(struct rtl8169_private *rtl_p)
 
 static void rtl_hw_start(struct  rtl8169_private *rtl_p)
 {
+	ktime_t start = ktime_get();
+
+	memset(&rtl_p->script, 0, sizeof(rtl_p->script));
+	rtl_regtrace_begin(rtl_p, RTL_TRACE_HW_START);
+
 	rtl_unlock_config_regs(rtl_p);
 	/* disable aspm and clock request before ephy access */
 	rtl_hw_aspm_clkreq_enable(rtl_p, false);
@@ -3757,8 +5317,11 @@ static void rtl_hw_start(struct  rtl8169_private *rtl_p)
 	else
 		rtl_hw_start_8168(rtl_p);
 
+	if (rtl_supports_eee(rtl_p) && !rtl_eee_lpi_wanted(rtl_p))
+		rtl_eee_mac_lpi(rtl_p, false);
+
 	rtl_enable_exit_l1(rtl_p);
-	rtl_hw_aspm_clkreq_enable(rtl_p, true);
+	rtl_hw_aspm_clkreq_enable(rtl_p, !rtl_p->aspm.busy);
 	rtl_set_rx_max_size(rtl_p);
 	rtl_set_rx_tx_desc_registers(rtl_p);
 	rtl_lock_config_regs(rtl_p);
@@ -3774,26 +5337,9 @@ static void rtl_hw_start(struct  rtl8169_private *rtl_p)
 	rtl_set_rx_config_features(rtl_p, rtl_p->netdev->features);
 	rtl_set_rx_mode(rtl_p->netdev);
 	rtl_irq_enable(rtl_p);
-}
-
-static int rtl8169_change_mtu(struct net_device *netdev, int new_mtu)
-{
-	struct rtl8169_private *rtl_p = netdev_priv(netdev);
-
-	netdev->mtu = new_mtu;
-	netdev_update_features(netdev);
-	rtl_jumbo_config(rtl_p);
-
-	switch (rtl_p->mac_version) {
-	case RTL_GIGA_MAC_VER_61:
-	case RTL_GIGA_MAC_VER_63:
-		rtl8125_set_eee_txidle_timer(rtl_p);
-		break;
-	default:
-		break;
-	}
 
-	return 0;
+	rtl_regtrace_end(rtl_p);
+	rtl_p->hw_start_us = ktime_us_delta(ktime_get(), start);
 }
 
 static void rtl8169_mark_to_asic(struct RxDesc *desc)
@@ -3831,21 +5377,25 @@ static struct page *rtl8169_alloc_rx_data(struct rtl8169_private *rtl_p,
 	return data;
 }
 
-static void rtl8169_rx_clear(struct rtl8169_private *rtl_p)
+static void __rtl8169_rx_clear(struct rtl8169_private *rtl_p, struct RxDesc *ring)
 {
 	int i;
 
 	for (i = 0; i < NUM_RX_DESC && rtl_p->Rx_databuff[i]; i++) {
-		dma_unmap_page(tp_to_dev(rtl_p),
-			       le64_to_cpu(rtl_p->RxDescArray[i].addr),
+		dma_unmap_page(tp_to_dev(rtl_p), le64_to_cpu(ring[i].addr),
 			       R8169_RX_BUF_SIZE, DMA_FROM_DEVICE);
 		__free_pages(rtl_p->Rx_databuff[i], get_order(R8169_RX_BUF_SIZE));
 		rtl_p->Rx_databuff[i] = NULL;
-		rtl_p->RxDescArray[i].addr = 0;
-		rtl_p->RxDescArray[i].opts1 = 0;
+		ring[i].addr = 0;
+		ring[i].opts1 = 0;
 	}
 }
 
+static void rtl8169_rx_clear(struct rtl8169_private *rtl_p)
+{
+	__rtl8169_rx_clear(rtl_p, rtl_p->RxDescArray);
+}
+
 static int rtl8169_rx_fill(struct rtl8169_private *rtl_p)
 {
 	int i;
@@ -3966,61 +5516,234 @@ static void rtl_reset_work(struct rtl8169_private *rtl_p)
 	rtl_hw_start(rtl_p);
 }
 
-static void rtl8169_tx_timeout(struct net_device *netdev, unsigned int txqueue)
+static bool rtl_wait_tx_idle(struct rtl8169_private *rtl_p)
 {
-	struct rtl8169_private *rtl_p = netdev_priv(netdev);
-
-	rtl_schedule_task(rtl_p, RTL_FLAG_TASK_TX_TIMEOUT);
+	switch (rtl_p->mac_version) {
+	case RTL_GIGA_MAC_VER_28:
+	case RTL_GIGA_MAC_VER_31:
+		return rtl_loop_wait_low(rtl_p, &rtl_npq_cond, 20, 2000);
+	case RTL_GIGA_MAC_VER_34 ... RTL_GIGA_MAC_VER_53:
+		return rtl_loop_wait_high(rtl_p, &rtl_txcfg_empty_cond, 100, 42);
+	case RTL_GIGA_MAC_VER_61 ... RTL_GIGA_MAC_VER_63:
+		return rtl_loop_wait_high(rtl_p, &rtl_tx_empty_cond, 100, 42);
+	default:
+		/* no Tx empty indication, give it time but don't claim idle */
+		fsleep(100);
+		return false;
+	}
 }
 
-static int rtl8169_tx_map(struct rtl8169_private *rtl_p, const u32 *opts, u32 len,
-			  void *addr, unsigned int entry, bool desc_own)
+/* Registers rtl_hw_start() sets up and a loss of context would reset */
+static void rtl_rpm_snapshot(struct rtl8169_private *rtl_p)
 {
-	struct TxDesc *txd = rtl_p->TxDescArray + entry;
-	struct device *d = tp_to_dev(rtl_p);
-	dma_addr_t mapping;
-	u32 opts1;
-	int ret;
-
-	mapping = dma_map_single(d, addr, len, DMA_TO_DEVICE);
-	ret = dma_mapping_error(d, mapping);
-	if (unlikely(ret)) {
-		if (net_ratelimit())
-			netdev_err(rtl_p->netdev, "Failed to map TX data!\n");
-		return ret;
-	}
+	rtl_p->rpm.tx_config = RTL_R32(rtl_p, TxConfig);
+	rtl_p->rpm.cp_cmd = RTL_R16(rtl_p, CPlusCmd);
+	rtl_p->rpm.rx_max_size = RTL_R16(rtl_p, RxMaxSize);
+	rtl_p->rpm.config2 = RTL_R8(rtl_p, Config2);
+	rtl_p->rpm.config5 = RTL_R8(rtl_p, Config5);
+	rtl_p->rpm.snap_valid = true;
+}
 
-	txd->addr = cpu_to_le64(mapping);
-	txd->opts2 = cpu_to_le32(opts[1]);
+static bool rtl_rpm_context_retained(struct rtl8169_private *rtl_p)
+{
+	if (!rtl_p->rpm.snap_valid)
+		return false;
 
-	opts1 = opts[0] | len;
-	if (entry == NUM_TX_DESC - 1)
-		opts1 |= RingEnd;
-	if (desc_own)
-		opts1 |= DescOwn;
-	txd->opts1 = cpu_to_le32(opts1);
+	rtl_p->rpm.snap_valid = false;
 
-	rtl_p->tx_skb[entry].len = len;
+	/* rtl_prepare_power_down() changed an EPHY setting of these */
+	if (rtl_p->mac_version == RTL_GIGA_MAC_VER_32 ||
+	    rtl_p->mac_version == RTL_GIGA_MAC_VER_33)
+		return false;
 
-	return 0;
+	return RTL_R32(rtl_p, TxConfig) == rtl_p->rpm.tx_config &&
+	       RTL_R16(rtl_p, CPlusCmd) == rtl_p->rpm.cp_cmd &&
+	       RTL_R16(rtl_p, RxMaxSize) == rtl_p->rpm.rx_max_size &&
+	       RTL_R8(rtl_p, Config2) == rtl_p->rpm.config2 &&
+	       RTL_R8(rtl_p, Config5) == rtl_p->rpm.config5;
 }
 
-static int rtl8169_xmit_frags(struct rtl8169_private *rtl_p, struct sk_buff *skb,
-			      const u32 *opts, unsigned int entry)
+/*
+ * Restart a chip that kept its context in D3hot. rtl8169_down() left it
+ * reset and idle, so only the rings, Rx/Tx and what down undid are set up
+ * again, the chip specific init and the PHY are left alone.
+ */
+static void rtl_hw_start_fast(struct rtl8169_private *rtl_p)
 {
-	struct skb_shared_info *info = skb_shinfo(skb);
-	unsigned int cur_frag;
+	int i;
 
-	for (cur_frag = 0; cur_frag < info->nr_frags; cur_frag++) {
-		const skb_frag_t *frag = info->frags + cur_frag;
-		void *addr = skb_frag_address(frag);
-		u32 len = skb_frag_size(frag);
+	for (i = 0; i < NUM_RX_DESC; i++)
+		rtl8169_mark_to_asic(rtl_p->RxDescArray + i);
 
-		entry = (entry + 1) % NUM_TX_DESC;
+	rtl_unlock_config_regs(rtl_p);
+	rtl_enable_exit_l1(rtl_p);
+	rtl_hw_aspm_clkreq_enable(rtl_p, !rtl_p->aspm.busy);
+	rtl_set_rx_tx_desc_registers(rtl_p);
+	rtl_lock_config_regs(rtl_p);
+	rtl_jumbo_config(rtl_p);
 
-		if (unlikely(rtl8169_tx_map(rtl_p, opts, len, addr, entry, true)))
-			goto err_out;
-	}
+	RTL_W16(rtl_p, CPlusCmd, rtl_p->cp_cmd);
+	/* interrupt coalescing set by ethtool or a profile */
+	RTL_W16(rtl_p, IntrMitigate, rtl_p->rpm.intr_mitigate);
+	if (rtl_p->mac_version >= RTL_GIGA_MAC_VER_40)
+		rtl_disable_rxdvgate(rtl_p);
+	rtl_pci_commit(rtl_p);
+
+	if (rtl_supports_eee(rtl_p))
+		rtl_eee_mac_lpi(rtl_p, rtl_eee_lpi_wanted(rtl_p));
+
+	RTL_W8(rtl_p, ChipCmd, CmdTxEnb | CmdRxEnb);
+	rtl_init_rxcfg(rtl_p);
+	rtl_set_tx_config_registers(rtl_p);
+	rtl_set_rx_config_features(rtl_p, rtl_p->netdev->features);
+	rtl_set_rx_mode(rtl_p->netdev);
+	rtl_irq_enable(rtl_p);
+}
+
+/*
+ * Reset only the Tx engine and ring. Rx descriptors, Rx config and the link
+ * are left alone, so reception continues while the Tx side is recovered.
+ * Returns false if the Tx engine didn't drain and a full reset is needed.
+ */
+static bool rtl_tx_reset_work(struct rtl8169_private *rtl_p)
+{
+	bool idle;
+
+	netif_stop_queue(rtl_p->netdev);
+	napi_disable(&rtl_p->napi);
+
+	/* Give a racing hard_start_xmit a few cycles to complete. */
+	synchronize_net();
+
+	rtl_irq_disable(rtl_p);
+
+	RTL_W8(rtl_p, ChipCmd, CmdRxEnb);
+	idle = rtl_wait_tx_idle(rtl_p);
+
+	/* a busy engine may still fetch the ring, the full reset clears it */
+	if (idle) {
+		rtl8169_tx_clear(rtl_p);
+		rtl_p->dirty_tx = rtl_p->cur_tx = 0;
+
+		RTL_W32(rtl_p, TxDescStartAddrHigh, ((u64) rtl_p->TxPhyAddr) >> 32);
+		RTL_W32(rtl_p, TxDescStartAddrLow, ((u64) rtl_p->TxPhyAddr) & DMA_BIT_MASK(32));
+		RTL_W8(rtl_p, ChipCmd, CmdTxEnb | CmdRxEnb);
+		rtl_set_tx_config_registers(rtl_p);
+	}
+
+	napi_enable(&rtl_p->napi);
+	if (idle)
+		rtl_irq_enable(rtl_p);
+
+	return idle;
+}
+
+/*
+ * Stop DMA only while the jumbo and offload registers are reprogrammed. Rx
+ * buffers are R8169_RX_BUF_SIZE on all chips and RxMaxSize doesn't depend on
+ * the MTU, so the Rx ring stays as it is and no reset is needed.
+ */
+static int rtl8169_change_mtu(struct net_device *netdev, int new_mtu)
+{
+	struct rtl8169_private *rtl_p = netdev_priv(netdev);
+	bool quiesce = test_bit(RTL_FLAG_TASK_ENABLED, rtl_p->wk.flags);
+	ktime_t start = ktime_get();
+
+	if (quiesce) {
+		napi_disable(&rtl_p->napi);
+		netif_tx_disable(netdev);
+		rtl_irq_disable(rtl_p);
+		rtl_rx_close(rtl_p);
+		/* if Tx doesn't drain, the Tx timeout recovery takes over */
+		rtl_wait_tx_idle(rtl_p);
+	}
+
+	/* the runtime PM snapshot doesn't cover this */
+	rtl_p->rpm.snap_valid = false;
+	netdev->mtu = new_mtu;
+	netdev_update_features(netdev);
+	rtl_jumbo_config(rtl_p);
+
+	switch (rtl_p->mac_version) {
+	case RTL_GIGA_MAC_VER_61:
+	case RTL_GIGA_MAC_VER_63:
+		rtl8125_set_eee_txidle_timer(rtl_p);
+		break;
+	default:
+		break;
+	}
+
+	if (quiesce) {
+		rtl_set_rx_mode(netdev);
+		napi_enable(&rtl_p->napi);
+		/* events acked while NAPI was off, poll re-enables the irq */
+		local_bh_disable();
+		napi_schedule(&rtl_p->napi);
+		local_bh_enable();
+		netif_wake_queue(netdev);
+		rtl_p->reconfig_us = ktime_us_delta(ktime_get(), start);
+		rtl_p->reconfigs++;
+	}
+
+	return 0;
+}
+
+static void rtl8169_tx_timeout(struct net_device *netdev, unsigned int txqueue)
+{
+	struct rtl8169_private *rtl_p = netdev_priv(netdev);
+
+	rtl_schedule_task(rtl_p, RTL_FLAG_TASK_TX_TIMEOUT);
+}
+
+static int rtl8169_tx_map(struct rtl8169_private *rtl_p, const u32 *opts, u32 len,
+			  void *addr, unsigned int entry, bool desc_own)
+{
+	struct TxDesc *txd = rtl_p->TxDescArray + entry;
+	struct device *d = tp_to_dev(rtl_p);
+	dma_addr_t mapping;
+	u32 opts1;
+	int ret;
+
+	mapping = dma_map_single(d, addr, len, DMA_TO_DEVICE);
+	ret = dma_mapping_error(d, mapping);
+	if (unlikely(ret)) {
+		rtl_sw_stat_inc(rtl_p, RTL_SW_TX_MAP_ERR);
+		if (net_ratelimit())
+			netdev_err(rtl_p->netdev, "Failed to map TX data!\n");
+		return ret;
+	}
+
+	txd->addr = cpu_to_le64(mapping);
+	txd->opts2 = cpu_to_le32(opts[1]);
+
+	opts1 = opts[0] | len;
+	if (entry == NUM_TX_DESC - 1)
+		opts1 |= RingEnd;
+	if (desc_own)
+		opts1 |= DescOwn;
+	txd->opts1 = cpu_to_le32(opts1);
+
+	rtl_p->tx_skb[entry].len = len;
+
+	return 0;
+}
+
+static int rtl8169_xmit_frags(struct rtl8169_private *rtl_p, struct sk_buff *skb,
+			      const u32 *opts, unsigned int entry)
+{
+	struct skb_shared_info *info = skb_shinfo(skb);
+	unsigned int cur_frag;
+
+	for (cur_frag = 0; cur_frag < info->nr_frags; cur_frag++) {
+		const skb_frag_t *frag = info->frags + cur_frag;
+		void *addr = skb_frag_address(frag);
+		u32 len = skb_frag_size(frag);
+
+		entry = (entry + 1) % NUM_TX_DESC;
+
+		if (unlikely(rtl8169_tx_map(rtl_p, opts, len, addr, entry, true)))
+			goto err_out;
+	}
 
 	return 0;
 
@@ -4193,6 +5916,10 @@ static bool rtl_chip_supports_csum_v2(struct rtl8169_private *rtl_p)
 
 static void rtl8169_doorbell(struct rtl8169_private *rtl_p)
 {
+	trace_r8169_doorbell(rtl_p->netdev, READ_ONCE(rtl_p->cur_tx));
+	rtl_sw_stat_inc(rtl_p, RTL_SW_DOORBELL);
+	rtl_sw_stat_inc(rtl_p, RTL_SW_MMIO_WRITE);
+
 	if (rtl_is_8125(rtl_p))
 		RTL_W16(rtl_p, TxPoll_8125, BIT(0));
 	else
@@ -4208,8 +5935,10 @@ static netdev_tx_t rtl8169_start_xmit(struct sk_buff *skb,
 	struct TxDesc *txd_first, *txd_last;
 	bool stop_queue, door_bell;
 	u32 opts[2];
+	int ret;
 
 	if (unlikely(!rtl_tx_slots_avail(rtl_p))) {
+		rtl_sw_stat_inc(rtl_p, RTL_SW_TX_RING_FULL);
 		if (net_ratelimit())
 			netdev_err(netdev, "BUG! Tx Ring full when queue awake!\n");
 		goto err_stop_0;
@@ -4248,16 +5977,25 @@ static netdev_tx_t rtl8169_start_xmit(struct sk_buff *skb,
 
 	txd_first->opts1 |= cpu_to_le32(DescOwn | FirstFrag);
 
+	trace_r8169_xmit(netdev, skb, txd_first - rtl_p->TxDescArray, frags);
+
 	/* rtl_tx needs to see descriptor changes before updated rtl_p->cur_tx */
 	smp_wmb();
 
 	WRITE_ONCE(rtl_p->cur_tx, rtl_p->cur_tx + frags + 1);
 
-	stop_queue = !netif_subqueue_maybe_stop(netdev, 0, rtl_tx_slots_avail(rtl_p),
-						R8169_TX_STOP_THRS,
-						R8169_TX_START_THRS);
+	ret = netif_subqueue_maybe_stop(netdev, 0, rtl_tx_slots_avail(rtl_p),
+					R8169_TX_STOP_THRS, R8169_TX_START_THRS);
+	stop_queue = !ret;
+	if (ret <= 0)
+		rtl_sw_stat_inc(rtl_p, RTL_SW_QUEUE_STOP);
+	if (ret < 0)
+		rtl_sw_stat_inc(rtl_p, RTL_SW_QUEUE_WAKE);
+
 	if (door_bell || stop_queue)
 		rtl8169_doorbell(rtl_p);
+	else
+		rtl_sw_stat_inc(rtl_p, RTL_SW_DOORBELL_SUPPRESSED);
 
 	return NETDEV_TX_OK;
 
@@ -4270,6 +6008,7 @@ err_dma_0:
 
 err_stop_0:
 	netif_stop_queue(netdev);
+	rtl_sw_stat_inc(rtl_p, RTL_SW_QUEUE_STOP);
 	netdev->stats.tx_dropped++;
 	return NETDEV_TX_BUSY;
 }
@@ -4372,6 +6111,7 @@ static void rtl_tx(struct net_device *netdev, struct rtl8169_private *rtl_p,
 		rtl8169_unmap_tx_skb(rtl_p, entry);
 
 		if (skb) {
+			rtl_rmon_count_tx(rtl_p, skb);
 			pkts_compl++;
 			bytes_compl += skb->len;
 			napi_consume_skb(skb, budget);
@@ -4380,12 +6120,15 @@ static void rtl_tx(struct net_device *netdev, struct rtl8169_private *rtl_p,
 	}
 
 	if (rtl_p->dirty_tx != dirty_tx) {
+		trace_r8169_tx_complete(netdev, pkts_compl, bytes_compl, dirty_tx);
 		dev_sw_netstats_tx_add(netdev, pkts_compl, bytes_compl);
 		WRITE_ONCE(rtl_p->dirty_tx, dirty_tx);
 
-		netif_subqueue_completed_wake(netdev, 0, pkts_compl, bytes_compl,
-					      rtl_tx_slots_avail(rtl_p),
-					      R8169_TX_START_THRS);
+		if (!netif_subqueue_completed_wake(netdev, 0, pkts_compl,
+						   bytes_compl,
+						   rtl_tx_slots_avail(rtl_p),
+						   R8169_TX_START_THRS))
+			rtl_sw_stat_inc(rtl_p, RTL_SW_QUEUE_WAKE);
 		/*
 		 * 8168 hack: TxPoll requests are lost when the Tx packets are
 		 * too close. Let's kick an extra TxPoll request when a burst
@@ -4437,6 +6180,10 @@ static int rtl_rx(struct net_device *netdev, struct rtl8169_private *rtl_p, int
 		 */
 		dma_rmb();
 
+		pkt_size = status & GENMASK(13, 0);
+		trace_r8169_rx(netdev, entry, status, pkt_size);
+		this_cpu_inc(rtl_p->sw_stats->rx_hist[rtl_rmon_bucket(pkt_size)]);
+
 		if (unlikely(status & RxRES)) {
 			if (net_ratelimit())
 				netdev_warn(netdev, "Rx ERROR. status = %08x\n",
@@ -4453,7 +6200,6 @@ static int rtl_rx(struct net_device *netdev, struct rtl8169_private *rtl_p, int
 				goto release_descriptor;
 		}
 
-		pkt_size = status & GENMASK(13, 0);
 		if (likely(!(netdev->features & NETIF_F_RXFCS)))
 			pkt_size -= ETH_FCS_LEN;
 
@@ -4461,6 +6207,7 @@ static int rtl_rx(struct net_device *netdev, struct rtl8169_private *rtl_p, int
 		 * They are seen as a symptom of over-mtu sized frames.
 		 */
 		if (unlikely(rtl8169_fragmented_frame(status))) {
+			rtl_sw_stat_inc(rtl_p, RTL_SW_RX_FRAG_DROP);
 			netdev->stats.rx_dropped++;
 			netdev->stats.rx_length_errors++;
 			goto release_descriptor;
@@ -4468,6 +6215,7 @@ static int rtl_rx(struct net_device *netdev, struct rtl8169_private *rtl_p, int
 
 		skb = napi_alloc_skb(&rtl_p->napi, pkt_size);
 		if (unlikely(!skb)) {
+			rtl_sw_stat_inc(rtl_p, RTL_SW_RX_ALLOC_ERR);
 			netdev->stats.rx_dropped++;
 			goto release_descriptor;
 		}
@@ -4505,8 +6253,12 @@ static irqreturn_t rtl8169_interrupt(int irq, void *dev_instance)
 	struct rtl8169_private *rtl_p = dev_instance;
 	u32 status = rtl_get_events(rtl_p);
 
-	if ((status & 0xffff) == 0xffff || !(status & rtl_p->irq_mask))
+	trace_r8169_irq(rtl_p->netdev, status);
+
+	if ((status & 0xffff) == 0xffff || !(status & rtl_p->irq_mask)) {
+		rtl_sw_stat_inc(rtl_p, RTL_SW_IRQ_NONE);
 		return IRQ_NONE;
+	}
 
 	if (unlikely(status & SYSErr)) {
 		rtl8169_pcierr_interrupt(rtl_p->netdev);
@@ -4523,8 +6275,9 @@ static irqreturn_t rtl8169_interrupt(int irq, void *dev_instance)
 	}
 
 	if (napi_schedule_prep(&rtl_p->napi)) {
-		rtl_irq_disable(rtl_p);
+		rtl_irq_disable_and_ack(rtl_p, status);
 		__napi_schedule(&rtl_p->napi);
+		return IRQ_HANDLED;
 	}
 out:
 	rtl_ack_events(rtl_p, status);
@@ -4536,6 +6289,8 @@ static void rtl_task(struct work_struct *work)
 {
 	struct rtl8169_private *rtl_p =
 		container_of(work, struct rtl8169_private, wk.work);
+	bool tx_only = false;
+	ktime_t start;
 	int ret;
 
 	rtnl_lock();
@@ -4553,6 +6308,14 @@ static void rtl_task(struct work_struct *work)
 				netif_device_detach(rtl_p->netdev);
 				goto out_unlock;
 			}
+		} else {
+			/*
+			 * Try a Tx-only reset first. If the previous Tx-only
+			 * recovery didn't help, escalate to a full reset.
+			 */
+			tx_only = !rtl_p->tx_recovered ||
+				  time_after(jiffies, rtl_p->tx_recover_jiffies +
+						      2 * rtl_p->netdev->watchdog_timeo);
 		}
 
 		/* ASPM compatibility issues are a typical reason for tx timeouts */
@@ -4560,14 +6323,32 @@ static void rtl_task(struct work_struct *work)
 							  PCIE_LINK_STATE_L0S);
 		if (!ret)
 			netdev_warn_once(rtl_p->netdev, "ASPM disabled on Tx timeout\n");
+
+		start = ktime_get();
+		if (tx_only && rtl_tx_reset_work(rtl_p)) {
+			rtl_p->tx_recover_us = ktime_us_delta(ktime_get(), start);
+			rtl_p->tx_recover_jiffies = jiffies;
+			rtl_p->tx_recovered = true;
+			netdev_warn(rtl_p->netdev, "Tx timeout, Tx-only reset took %lld us\n",
+				    rtl_p->tx_recover_us);
+			netif_wake_queue(rtl_p->netdev);
+			goto out_unlock;
+		}
+		rtl_p->tx_recovered = false;
 		goto reset;
 	}
 
 	if (test_and_clear_bit(RTL_FLAG_TASK_RESET_PENDING, rtl_p->wk.flags)) {
+		start = ktime_get();
 reset:
 		rtl_reset_work(rtl_p);
 		netif_wake_queue(rtl_p->netdev);
+		rtl_p->reset_us = ktime_us_delta(ktime_get(), start);
+		netdev_dbg(rtl_p->netdev, "full reset took %lld us\n", rtl_p->reset_us);
 	}
+
+	if (test_and_clear_bit(RTL_FLAG_TASK_COALESCE, rtl_p->wk.flags))
+		rtl_coalesce_work(rtl_p);
 out_unlock:
 	rtnl_unlock();
 }
@@ -4576,12 +6357,37 @@ static int rtl8169_poll(struct napi_struct *napi, int budget)
 {
 	struct rtl8169_private *rtl_p = container_of(napi, struct rtl8169_private, napi);
 	struct net_device *netdev = rtl_p->netdev;
+	unsigned int tx_pending;
+	u32 dirty_tx;
 	int work_done;
 
+	dirty_tx = rtl_p->dirty_tx;
+	tx_pending = READ_ONCE(rtl_p->cur_tx) - dirty_tx;
+	rtl_p->tx_occ_hist[min_t(unsigned int, tx_pending >> RTL_TX_OCC_SHIFT,
+				 RTL_TX_OCC_BUCKETS - 1)]++;
+
 	rtl_tx(netdev, rtl_p, budget);
 
 	work_done = rtl_rx(netdev, rtl_p, budget);
 
+	WRITE_ONCE(rtl_p->load.pkts, rtl_p->load.pkts + work_done +
+		   (rtl_p->dirty_tx - dirty_tx));
+
+	if (unlikely(READ_ONCE(rtl_p->rpm.wait_first_pkt)) &&
+	    (work_done || rtl_p->dirty_tx != dirty_tx)) {
+		rtl_p->rpm.first_pkt_us = ktime_us_delta(ktime_get(),
+							 rtl_p->rpm.resume_start);
+		WRITE_ONCE(rtl_p->rpm.wait_first_pkt, false);
+	}
+
+	rtl_p->rx_occ_hist[min_t(unsigned int, fls(work_done),
+				 RTL_RX_OCC_BUCKETS - 1)]++;
+
+	trace_r8169_napi_poll(netdev, work_done, budget);
+	rtl_sw_stat_inc(rtl_p, RTL_SW_NAPI_POLL);
+	if (work_done == budget)
+		rtl_sw_stat_inc(rtl_p, RTL_SW_NAPI_BUDGET_EXHAUSTED);
+
 	if (work_done < budget && napi_complete_done(napi, work_done))
 		rtl_irq_enable(rtl_p);
 
@@ -4595,6 +6401,8 @@ static void r8169_phylink_handler(struct net_device *ndev)
 
 	if (netif_carrier_ok(ndev)) {
 		rtl_link_chg_patch(rtl_p);
+		if (rtl_p->coal_set)
+			rtl_schedule_task(rtl_p, RTL_FLAG_TASK_COALESCE);
 		pm_request_resume(d);
 		netif_wake_queue(rtl_p->netdev);
 	} else {
@@ -4634,7 +6442,18 @@ static void rtl8169_down(struct rtl8169_private *rtl_p)
 	/* Clear all task flags */
 	bitmap_zero(rtl_p->wk.flags, RTL_FLAG_MAX);
 
-	phy_stop(rtl_p->phydev);
+	rtl_load_policy_stop(rtl_p);
+	/* the next rtl_hw_start() enables ASPM and LPI again */
+	rtl_p->aspm.busy = rtl_p->aspm.off;
+	rtl_p->eee.busy = false;
+
+	if (rtl_p->aer.quiesced) {
+		/* PCI error recovery failed and left NAPI and the PHY stopped */
+		rtl_p->aer.quiesced = false;
+		napi_enable(&rtl_p->napi);
+	} else {
+		phy_stop(rtl_p->phydev);
+	}
 
 	rtl8169_update_counters(rtl_p);
 
@@ -4646,19 +6465,113 @@ static void rtl8169_down(struct rtl8169_private *rtl_p)
 	rtl_prepare_power_down(rtl_p);
 }
 
-static void rtl8169_up(struct rtl8169_private *rtl_p)
+/* fast: the chip kept its context, see rtl_rpm_context_retained() */
+static void rtl8169_up(struct rtl8169_private *rtl_p, bool resume, bool fast)
 {
 	pci_set_master(rtl_p->pcidev);
-	phy_init_hw(rtl_p->phydev);
+	if (!fast) {
+		/* PHY may have lost power while we were down */
+		rtl_phy_shadow_flush(rtl_p);
+		phy_init_hw(rtl_p->phydev);
+	}
 	phy_resume(rtl_p->phydev);
-	rtl8169_init_phy(rtl_p);
+	if (!fast)
+		rtl8169_init_phy(rtl_p, resume);
 	napi_enable(&rtl_p->napi);
 	set_bit(RTL_FLAG_TASK_ENABLED, rtl_p->wk.flags);
-	rtl_reset_work(rtl_p);
+	if (fast) {
+		rtl_hw_start_fast(rtl_p);
+		rtl_p->rpm.fast_resumes++;
+	} else {
+		rtl_reset_work(rtl_p);
+	}
+	rtl_load_policy_start(rtl_p);
 
 	phy_start(rtl_p->phydev);
 }
 
+/* Must be called with pool.lock held */
+static void rtl_pool_free(struct rtl8169_private *rtl_p)
+{
+	struct device *d = tp_to_dev(rtl_p);
+
+	if (!rtl_p->pool.tx_desc)
+		return;
+
+	__rtl8169_rx_clear(rtl_p, rtl_p->pool.rx_desc);
+	dma_free_coherent(d, R8169_RX_RING_BYTES, rtl_p->pool.rx_desc,
+			  rtl_p->pool.rx_phys);
+	dma_free_coherent(d, R8169_TX_RING_BYTES, rtl_p->pool.tx_desc,
+			  rtl_p->pool.tx_phys);
+	rtl_p->pool.rx_desc = NULL;
+	rtl_p->pool.tx_desc = NULL;
+}
+
+/*
+ * Park the rings and the Rx buffers of a closed interface, so that the next
+ * rtl_open() doesn't have to allocate and map them again.
+ */
+static void rtl_pool_put(struct rtl8169_private *rtl_p)
+{
+	mutex_lock(&rtl_p->pool.lock);
+	rtl_p->pool.tx_desc = rtl_p->TxDescArray;
+	rtl_p->pool.tx_phys = rtl_p->TxPhyAddr;
+	rtl_p->pool.rx_desc = rtl_p->RxDescArray;
+	rtl_p->pool.rx_phys = rtl_p->RxPhyAddr;
+	mutex_unlock(&rtl_p->pool.lock);
+
+	rtl_p->TxDescArray = NULL;
+	rtl_p->RxDescArray = NULL;
+}
+
+static bool rtl_pool_get(struct rtl8169_private *rtl_p)
+{
+	bool reused = false;
+
+	mutex_lock(&rtl_p->pool.lock);
+	if (rtl_p->pool.tx_desc) {
+		rtl_p->TxDescArray = rtl_p->pool.tx_desc;
+		rtl_p->TxPhyAddr = rtl_p->pool.tx_phys;
+		rtl_p->RxDescArray = rtl_p->pool.rx_desc;
+		rtl_p->RxPhyAddr = rtl_p->pool.rx_phys;
+		rtl_p->pool.tx_desc = NULL;
+		rtl_p->pool.rx_desc = NULL;
+		rtl_p->pool.reused++;
+		reused = true;
+	}
+	mutex_unlock(&rtl_p->pool.lock);
+
+	return reused;
+}
+
+static unsigned long rtl_pool_shrink_count(struct shrinker *shrink,
+					   struct shrink_control *sc)
+{
+	struct rtl8169_private *rtl_p =
+		container_of(shrink, struct rtl8169_private, pool_shrinker);
+
+	return READ_ONCE(rtl_p->pool.tx_desc) ? R8169_POOL_PAGES : 0;
+}
+
+static unsigned long rtl_pool_shrink_scan(struct shrinker *shrink,
+					  struct shrink_control *sc)
+{
+	struct rtl8169_private *rtl_p =
+		container_of(shrink, struct rtl8169_private, pool_shrinker);
+	unsigned long freed = 0;
+
+	if (!mutex_trylock(&rtl_p->pool.lock))
+		return SHRINK_STOP;
+
+	if (rtl_p->pool.tx_desc) {
+		rtl_pool_free(rtl_p);
+		freed = R8169_POOL_PAGES;
+	}
+	mutex_unlock(&rtl_p->pool.lock);
+
+	return freed;
+}
+
 static int rtl8169_close(struct net_device *netdev)
 {
 	struct rtl8169_private *rtl_p = netdev_priv(netdev);
@@ -4668,20 +6581,26 @@ static int rtl8169_close(struct net_device *netdev)
 
 	netif_stop_queue(netdev);
 	rtl8169_down(rtl_p);
-	rtl8169_rx_clear(rtl_p);
+	if (!(rtl_p->priv_flags & RTL_PRIV_FLAG_RETAIN_RINGS))
+		rtl8169_rx_clear(rtl_p);
 
 	cancel_work_sync(&rtl_p->wk.work);
 
+	irq_update_affinity_hint(rtl_p->irq, NULL);
 	free_irq(rtl_p->irq, rtl_p);
 
 	phy_disconnect(rtl_p->phydev);
 
-	dma_free_coherent(&pcidev->dev, R8169_RX_RING_BYTES, rtl_p->RxDescArray,
-			  rtl_p->RxPhyAddr);
-	dma_free_coherent(&pcidev->dev, R8169_TX_RING_BYTES, rtl_p->TxDescArray,
-			  rtl_p->TxPhyAddr);
-	rtl_p->TxDescArray = NULL;
-	rtl_p->RxDescArray = NULL;
+	if (rtl_p->priv_flags & RTL_PRIV_FLAG_RETAIN_RINGS) {
+		rtl_pool_put(rtl_p);
+	} else {
+		dma_free_coherent(&pcidev->dev, R8169_RX_RING_BYTES,
+				  rtl_p->RxDescArray, rtl_p->RxPhyAddr);
+		dma_free_coherent(&pcidev->dev, R8169_TX_RING_BYTES,
+				  rtl_p->TxDescArray, rtl_p->TxPhyAddr);
+		rtl_p->TxDescArray = NULL;
+		rtl_p->RxDescArray = NULL;
+	}
 
 	pm_runtime_put_sync(&pcidev->dev);
 
@@ -4697,15 +6616,40 @@ static void rtl8169_netpoll(struct net_device *netdev)
 }
 #endif
 
+/*
+ * Rings, Rx buffers and the counters are allocated on the device's node by
+ * the DMA API and rtl8169_alloc_rx_data(), the PCI core probes on that node
+ * too. Steer the interrupt and with it NAPI to the same node.
+ */
+static void rtl_irq_affinity_hint(struct rtl8169_private *rtl_p)
+{
+	int node = dev_to_node(tp_to_dev(rtl_p));
+
+	if (node == NUMA_NO_NODE)
+		return;
+
+	if (irq_set_affinity_and_hint(rtl_p->irq, cpumask_of_node(node)))
+		netdev_dbg(rtl_p->netdev, "can't set IRQ affinity\n");
+}
+
 static int rtl_open(struct net_device *netdev)
 {
 	struct rtl8169_private *rtl_p = netdev_priv(netdev);
 	struct pci_dev *pcidev = rtl_p->pcidev;
 	unsigned long irqflags;
 	int retval = -ENOMEM;
+	ktime_t start;
 
+	start = ktime_get();
 	pm_runtime_get_sync(&pcidev->dev);
 
+	if (rtl_pool_get(rtl_p)) {
+		/* Tx ring was cleaned on close, Rx buffers are still mapped */
+		rtl8169_init_ring_indexes(rtl_p);
+		memset(rtl_p->tx_skb, 0, sizeof(rtl_p->tx_skb));
+		goto wait_fw;
+	}
+
 	/*
 	 * Rx and Tx descriptors needs 256 bytes alignment.
 	 * dma_alloc_coherent provides more.
@@ -4724,29 +6668,32 @@ static int rtl_open(struct net_device *netdev)
 	if (retval < 0)
 		goto err_free_rx_1;
 
-	rtl_request_firmware(rtl_p);
+wait_fw:
+	rtl_wait_firmware(rtl_p);
 
 	irqflags = pci_dev_msi_enabled(pcidev) ? IRQF_NO_THREAD : IRQF_SHARED;
 	retval = request_irq(rtl_p->irq, rtl8169_interrupt, irqflags, netdev->name, rtl_p);
 	if (retval < 0)
-		goto err_release_fw_2;
+		goto err_rx_clear_2;
+	rtl_irq_affinity_hint(rtl_p);
 
 	retval = r8169_phy_connect(rtl_p);
 	if (retval)
 		goto err_free_irq;
 
-	rtl8169_up(rtl_p);
+	rtl8169_up(rtl_p, false, false);
 	rtl8169_init_counter_offsets(rtl_p);
 	netif_start_queue(netdev);
+	rtl_p->open_us = ktime_us_delta(ktime_get(), start);
 out:
 	pm_runtime_put_sync(&pcidev->dev);
 
 	return retval;
 
 err_free_irq:
+	irq_update_affinity_hint(rtl_p->irq, NULL);
 	free_irq(rtl_p->irq, rtl_p);
-err_release_fw_2:
-	rtl_release_firmware(rtl_p);
+err_rx_clear_2:
 	rtl8169_rx_clear(rtl_p);
 err_free_rx_1:
 	dma_free_coherent(&pcidev->dev, R8169_RX_RING_BYTES, rtl_p->RxDescArray,
@@ -4805,12 +6752,23 @@ static void rtl8169_net_suspend(struct rtl8169_private *rtl_p)
 static int rtl8169_runtime_resume(struct device *dev)
 {
 	struct rtl8169_private *rtl_p = dev_get_drvdata(dev);
+	ktime_t start = ktime_get();
+	bool fast;
+
+	/* before restoring WoL, which owns bits of Config2 and Config5 */
+	fast = rtl_p->TxDescArray && rtl_rpm_context_retained(rtl_p);
 
 	rtl_rar_set(rtl_p, rtl_p->netdev->dev_addr);
 	__rtl8169_set_wol(rtl_p, rtl_p->saved_wolopts);
 
-	if (rtl_p->TxDescArray)
-		rtl8169_up(rtl_p);
+	if (rtl_p->TxDescArray) {
+		rtl8169_up(rtl_p, true, fast);
+		rtl_p->resume_us = ktime_us_delta(ktime_get(), start);
+		rtl_p->rpm.resumes++;
+		rtl_p->rpm.resume_start = start;
+		WRITE_ONCE(rtl_p->rpm.wait_first_pkt, true);
+	}
+	rtl_p->rpm.keep_link = false;
 
 	netif_device_attach(rtl_p->netdev);
 
@@ -4822,6 +6780,7 @@ static int rtl8169_suspend(struct device *device)
 	struct rtl8169_private *rtl_p = dev_get_drvdata(device);
 
 	rtnl_lock();
+	rtl_p->rpm.snap_valid = false;
 	rtl8169_net_suspend(rtl_p);
 	if (!device_may_wakeup(tp_to_dev(rtl_p)))
 		clk_disable_unprepare(rtl_p->clk);
@@ -4855,7 +6814,11 @@ static int rtl8169_runtime_suspend(struct device *device)
 
 	rtnl_lock();
 	__rtl8169_set_wol(rtl_p, WAKE_PHY);
+	rtl_p->rpm.intr_mitigate = RTL_R16(rtl_p, IntrMitigate);
+	rtl_p->rpm.keep_link = rtl_p->rpm.no_soft_reset;
 	rtl8169_net_suspend(rtl_p);
+	if (rtl_p->rpm.no_soft_reset)
+		rtl_rpm_snapshot(rtl_p);
 	rtnl_unlock();
 
 	return 0;
@@ -4908,6 +6871,10 @@ static void rtl_remove_one(struct pci_dev *pcidev)
 
 	unregister_netdev(rtl_p->netdev);
 
+	mutex_lock(&rtl_p->pool.lock);
+	rtl_pool_free(rtl_p);
+	mutex_unlock(&rtl_p->pool.lock);
+
 	if (rtl_p->dash_type != RTL_DASH_NONE)
 		rtl8168_driver_stop(rtl_p);
 
@@ -5173,54 +7140,883 @@ static bool rtl_aspm_is_safe(struct rtl8169_private *rtl_p)
 	return false;
 }
 
-static int rtl_init_one(struct pci_dev *pcidev, const struct pci_device_id *ent)
+static const char * const rtl_probe_phase_names[RTL_PROBE_MAX] = {
+	[RTL_PROBE_ENABLE]	= "enable",
+	[RTL_PROBE_DETECT]	= "detect",
+	[RTL_PROBE_HW_INIT]	= "hw_init",
+	[RTL_PROBE_SETUP]	= "setup",
+	[RTL_PROBE_MDIO]	= "mdio",
+	[RTL_PROBE_REGISTER]	= "register",
+};
+
+static int rtl_latency_show(struct seq_file *m, void *v)
 {
-	struct rtl8169_private *rtl_p;
-	int jumbo_max, region, rc;
-	enum mac_version chipset;
-	struct net_device *netdev;
-	u32 txconfig;
-	u16 xid;
+	struct rtl8169_private *rtl_p = m->private;
+	int i;
 
-	printk(KERN_ALERT "%s() called!\n", __func__);
-	netdev = devm_alloc_etherdev(&pcidev->dev, sizeof (*rtl_p));
-	if (!netdev)
-		return -ENOMEM;
+	seq_printf(m, "probe_us: %lld\n", rtl_p->probe_total_us);
+	for (i = 0; i < RTL_PROBE_MAX; i++)
+		seq_printf(m, "probe_%s_us: %lld\n", rtl_probe_phase_names[i],
+			   rtl_p->probe_us[i]);
+	seq_printf(m, "open_us: %lld\n", rtl_p->open_us);
+	seq_printf(m, "open_rings_reused: %u\n", rtl_p->pool.reused);
+	seq_printf(m, "resume_us: %lld\n", rtl_p->resume_us);
+	seq_printf(m, "resume_first_pkt_us: %lld\n", rtl_p->rpm.first_pkt_us);
+	seq_printf(m, "resume_fast: %u of %u\n", rtl_p->rpm.fast_resumes,
+		   rtl_p->rpm.resumes);
+	seq_printf(m, "tx_recover_us: %lld\n", rtl_p->tx_recover_us);
+	seq_printf(m, "reset_us: %lld\n", rtl_p->reset_us);
+	seq_printf(m, "reconfig_us: %lld count %u\n", rtl_p->reconfig_us,
+		   rtl_p->reconfigs);
+	seq_printf(m, "aer_recover_us: %lld recovered %u of %u\n",
+		   rtl_p->aer.recover_us, rtl_p->aer.recoveries, rtl_p->aer.errors);
+	seq_printf(m, "phy_config_us: %lld skipped %u\n", rtl_p->phy_config_us,
+		   rtl_p->phy_config_skipped);
+	seq_printf(m, "hw_start_us: %lld\n", rtl_p->hw_start_us);
+	seq_printf(m, "fw_apply_us: %lld applied %u\n", rtl_p->fw_apply_us,
+		   rtl_p->fw_applied);
+	seq_printf(m, "fw_wait_us: %lld\n", rtl_p->fw_wait_us);
+	seq_printf(m, "hw_start_ops: %u merged %u\n", rtl_p->script.ops,
+		   rtl_p->script.merged);
+	seq_printf(m, "hw_start_reads: %u elided %u\n", rtl_p->script.reads,
+		   rtl_p->script.reads_elided);
+	seq_printf(m, "hw_start_writes: %u\n", rtl_p->script.writes);
 
-	// set pcidev's dev as netdev's dev.parent (i.e., netdev is a child to pcidev)
-	SET_NETDEV_DEV(netdev, &pcidev->dev);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rtl_latency);
 
-	netdev->netdev_ops = &rtl_netdev_ops;
-	rtl_p = netdev_priv(netdev);
-	rtl_p->netdev = netdev;
-	rtl_p->pcidev = pcidev;
-	rtl_p->supports_gmii = ent->driver_data == RTL_CFG_NO_GBIT ? 0 : 1;
-	rtl_p->eee_adv = -1;
-	rtl_p->ocp_base = OCP_STD_PHY_BASE;
+struct rtl_ring_snapshot {
+	struct TxDesc tx[NUM_TX_DESC];
+	struct RxDesc rx[NUM_RX_DESC];
+	u32 cur_tx;
+	u32 dirty_tx;
+	u32 cur_rx;
+	u32 intr_mask;
+	u32 intr_status;
+	u16 intr_mitigate;
+	u8 chip_cmd;
+};
 
-	raw_spin_lock_init(&rtl_p->cfg9346_usage_lock);
-	raw_spin_lock_init(&rtl_p->config25_lock);
-	raw_spin_lock_init(&rtl_p->mac_ocp_lock);
+/*
+ * Take a consistent copy of both rings: NAPI is stopped and the Tx queue is
+ * locked while copying, so neither the indices nor the descriptors move.
+ */
+static void rtl_ring_snapshot(struct rtl8169_private *rtl_p,
+			      struct rtl_ring_snapshot *snap)
+{
+	struct net_device *netdev = rtl_p->netdev;
 
-	netdev->tstats = devm_netdev_alloc_pcpu_stats(&pcidev->dev,
-						   struct pcpu_sw_netstats);
-	if (!netdev->tstats)
-		return -ENOMEM;
+	napi_disable(&rtl_p->napi);
+	netif_tx_lock_bh(netdev);
 
-	/* Get the *optional* external "ether_clk" used on some boards */
-	rtl_p->clk = devm_clk_get_optional_enabled(&pcidev->dev, "ether_clk");
-	if (IS_ERR(rtl_p->clk))
-		return dev_err_probe(&pcidev->dev, PTR_ERR(rtl_p->clk), "failed to get ether_clk\n");
+	snap->cur_tx = rtl_p->cur_tx;
+	snap->dirty_tx = rtl_p->dirty_tx;
+	snap->cur_rx = rtl_p->cur_rx;
+	memcpy(snap->tx, rtl_p->TxDescArray, sizeof(snap->tx));
+	memcpy(snap->rx, rtl_p->RxDescArray, sizeof(snap->rx));
 
-	/* enable device (incl. PCI PM wakeup and hotplug setup) */
-	rc = pcim_enable_device(pcidev);
-	if (rc < 0)
-		return dev_err_probe(&pcidev->dev, rc, "enable failure\n");
+	if (rtl_is_8125(rtl_p)) {
+		snap->intr_mask = RTL_R32(rtl_p, IntrMask_8125);
+		snap->intr_status = RTL_R32(rtl_p, IntrStatus_8125);
+	} else {
+		snap->intr_mask = RTL_R16(rtl_p, IntrMask);
+		snap->intr_status = RTL_R16(rtl_p, IntrStatus);
+	}
+	snap->intr_mitigate = RTL_R16(rtl_p, IntrMitigate);
+	snap->chip_cmd = RTL_R8(rtl_p, ChipCmd);
 
-	if (pcim_set_mwi(pcidev) < 0)
-		dev_info(&pcidev->dev, "Mem-Wr-Inval unavailable\n");
+	netif_tx_unlock_bh(netdev);
+	napi_enable(&rtl_p->napi);
 
-	/* use first MMIO region */
+	/* interrupts seen while NAPI was off didn't schedule a poll */
+	local_bh_disable();
+	napi_schedule(&rtl_p->napi);
+	local_bh_enable();
+}
+
+static void rtl_show_desc(struct seq_file *m, unsigned int i, u32 opts1,
+			  u32 opts2, u64 addr, unsigned int len)
+{
+	seq_printf(m, "%3u: %08x %08x %016llx %s%s%s%s len %u\n", i, opts1,
+		   opts2, addr, opts1 & DescOwn ? "OWN " : "",
+		   opts1 & RingEnd ? "EOR " : "",
+		   opts1 & FirstFrag ? "FS " : "",
+		   opts1 & LastFrag ? "LS " : "", len);
+}
+
+static int rtl_rings_show(struct seq_file *m, void *v)
+{
+	struct rtl8169_private *rtl_p = m->private;
+	struct device *d = tp_to_dev(rtl_p);
+	struct rtl_ring_snapshot *snap;
+	unsigned int i;
+
+	snap = kmalloc(sizeof(*snap), GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	rtnl_lock();
+
+	if (!netif_running(rtl_p->netdev) || !rtl_p->TxDescArray) {
+		seq_puts(m, "interface down\n");
+		goto out_unlock;
+	}
+
+	/* NAPI is disabled while runtime suspended */
+	if (pm_runtime_get_if_active(d, true) <= 0) {
+		seq_puts(m, "device suspended\n");
+		goto out_unlock;
+	}
+
+	rtl_ring_snapshot(rtl_p, snap);
+	pm_runtime_put_noidle(d);
+
+	rtnl_unlock();
+
+	seq_printf(m, "cur_tx: %u\ndirty_tx: %u\ncur_rx: %u\n",
+		   snap->cur_tx, snap->dirty_tx, snap->cur_rx);
+	seq_printf(m, "tx_slots_avail: %u\n",
+		   snap->dirty_tx + NUM_TX_DESC - snap->cur_tx);
+	seq_printf(m, "irq_mask: 0x%08x\n", rtl_p->irq_mask);
+	seq_printf(m, "IntrMask: 0x%08x\nIntrStatus: 0x%08x\n",
+		   snap->intr_mask, snap->intr_status);
+	seq_printf(m, "IntrMitigate: 0x%04x\nChipCmd: 0x%02x\n",
+		   snap->intr_mitigate, snap->chip_cmd);
+
+	seq_puts(m, "\ntx ring: entry opts1 opts2 addr\n");
+	for (i = 0; i < NUM_TX_DESC; i++) {
+		u32 opts1 = le32_to_cpu(snap->tx[i].opts1);
+
+		rtl_show_desc(m, i, opts1, le32_to_cpu(snap->tx[i].opts2),
+			      le64_to_cpu(snap->tx[i].addr), opts1 & 0xffff);
+	}
+
+	seq_puts(m, "\nrx ring: entry opts1 opts2 addr\n");
+	for (i = 0; i < NUM_RX_DESC; i++) {
+		u32 opts1 = le32_to_cpu(snap->rx[i].opts1);
+
+		rtl_show_desc(m, i, opts1, le32_to_cpu(snap->rx[i].opts2),
+			      le64_to_cpu(snap->rx[i].addr), opts1 & GENMASK(13, 0));
+	}
+
+	kfree(snap);
+
+	return 0;
+
+out_unlock:
+	rtnl_unlock();
+	kfree(snap);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rtl_rings);
+
+static int rtl_occupancy_show(struct seq_file *m, void *v)
+{
+	struct rtl8169_private *rtl_p = m->private;
+	unsigned int i;
+
+	seq_puts(m, "tx descriptors pending at poll:\n");
+	for (i = 0; i < RTL_TX_OCC_BUCKETS; i++)
+		seq_printf(m, "%3u-%3u: %llu\n", i << RTL_TX_OCC_SHIFT,
+			   ((i + 1) << RTL_TX_OCC_SHIFT) - 1,
+			   READ_ONCE(rtl_p->tx_occ_hist[i]));
+
+	seq_puts(m, "rx descriptors processed per poll:\n");
+	seq_printf(m, "      0: %llu\n", READ_ONCE(rtl_p->rx_occ_hist[0]));
+	for (i = 1; i < RTL_RX_OCC_BUCKETS; i++)
+		seq_printf(m, "%3u-%3u: %llu\n", 1 << (i - 1), (1 << i) - 1,
+			   READ_ONCE(rtl_p->rx_occ_hist[i]));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rtl_occupancy);
+
+static int rtl_phy_shadow_show(struct seq_file *m, void *v)
+{
+	struct rtl8169_private *rtl_p = m->private;
+	struct rtl_phy_shadow *sh = &rtl_p->phy_shadow;
+
+	seq_printf(m, "hits: %u\npage_elided: %u\nmismatches: %u\n",
+		   sh->hits, sh->page_elided, sh->mismatches);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rtl_phy_shadow);
+
+static void rtl_cond_show_hist(struct seq_file *m, const char *what,
+			       atomic_long_t *hist)
+{
+	unsigned int i;
+
+	seq_printf(m, "  %-6s", what);
+	for (i = 0; i < RTL_COND_HIST_BUCKETS; i++)
+		seq_printf(m, " %lu", atomic_long_read(&hist[i]));
+	seq_putc(m, '\n');
+}
+
+static int rtl_cond_wait_show(struct seq_file *m, void *v)
+{
+	struct rtl_cond_stats *st;
+
+	seq_puts(m, "# log2 buckets: 0 1 2-3 4-7 ... 16384+\n");
+
+	spin_lock(&rtl_cond_list_lock);
+	list_for_each_entry(st, &rtl_cond_list, list) {
+		seq_printf(m, "%s: timeouts %lu max_us %lu total_us %lu avg_ns %lu spin_hits %lu spin_misses %lu\n",
+			   st->name, atomic_long_read(&st->timeouts),
+			   atomic_long_read(&st->max_usecs),
+			   atomic_long_read(&st->total_usecs),
+			   atomic_long_read(&st->avg_nsecs),
+			   atomic_long_read(&st->spin_hits),
+			   atomic_long_read(&st->spin_misses));
+		rtl_cond_show_hist(m, "iters", st->iter_hist);
+		rtl_cond_show_hist(m, "usecs", st->usec_hist);
+	}
+	spin_unlock(&rtl_cond_list_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rtl_cond_wait);
+
+#ifdef R8169_REGTRACE
+static const char * const rtl_regtrace_phases[] = {
+	[RTL_TRACE_OFF]		= "off",
+	[RTL_TRACE_HW_START]	= "hw_start",
+	[RTL_TRACE_PHY_CONFIG]	= "phy_config",
+};
+
+static const char * const rtl_regtrace_spaces[] = {
+	[RTL_TRACE_MMIO8]	= "mmio8",
+	[RTL_TRACE_MMIO16]	= "mmio16",
+	[RTL_TRACE_MMIO32]	= "mmio32",
+	[RTL_TRACE_ERI]		= "eri",
+	[RTL_TRACE_MAC_OCP]	= "mac_ocp",
+	[RTL_TRACE_PHY]		= "phy",
+	[RTL_TRACE_EPHY]	= "ephy",
+};
+
+/* index of the oldest entry still in the ring */
+static u32 rtl_regtrace_first(struct rtl_regtrace *rt)
+{
+	return rt->head > RTL_REGTRACE_ENTRIES ?
+	       rt->head - RTL_REGTRACE_ENTRIES : 0;
+}
+
+static void *rtl_regtrace_seq_start(struct seq_file *m, loff_t *pos)
+{
+	struct rtl8169_private *rtl_p = m->private;
+	struct rtl_regtrace *rt = &rtl_p->regtrace;
+
+	if (!*pos)
+		return SEQ_START_TOKEN;
+
+	if (rtl_regtrace_first(rt) + *pos - 1 >= rt->head)
+		return NULL;
+
+	return &rt->buf[(rtl_regtrace_first(rt) + *pos - 1) %
+			RTL_REGTRACE_ENTRIES];
+}
+
+static void *rtl_regtrace_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+
+	return rtl_regtrace_seq_start(m, pos);
+}
+
+static void rtl_regtrace_seq_stop(struct seq_file *m, void *v)
+{
+}
+
+static int rtl_regtrace_seq_show(struct seq_file *m, void *v)
+{
+	struct rtl8169_private *rtl_p = m->private;
+	struct rtl_regtrace *rt = &rtl_p->regtrace;
+	struct rtl_regtrace_entry e;
+	unsigned long flags;
+
+	if (v == SEQ_START_TOKEN) {
+		seq_printf(m, "chip %s\n", rtl_chip_infos[rtl_p->mac_version].name);
+		seq_printf(m, "recorded %u lost %u\n", rt->head,
+			   rtl_regtrace_first(rt));
+		return 0;
+	}
+
+	raw_spin_lock_irqsave(&rt->lock, flags);
+	e = *(struct rtl_regtrace_entry *)v;
+	raw_spin_unlock_irqrestore(&rt->lock, flags);
+
+	if (e.phase >= ARRAY_SIZE(rtl_regtrace_phases) ||
+	    e.space >= ARRAY_SIZE(rtl_regtrace_spaces))
+		return 0;
+
+	seq_printf(m, "%s %s %c %04x %08x %04x\n", rtl_regtrace_phases[e.phase],
+		   e.op == 'B' ? "-" : rtl_regtrace_spaces[e.space], e.op,
+		   e.addr, e.val, e.aux);
+
+	return 0;
+}
+
+static const struct seq_operations rtl_regtrace_seq_ops = {
+	.start	= rtl_regtrace_seq_start,
+	.next	= rtl_regtrace_seq_next,
+	.stop	= rtl_regtrace_seq_stop,
+	.show	= rtl_regtrace_seq_show,
+};
+
+static int rtl_regtrace_open(struct inode *inode, struct file *file)
+{
+	int rc = seq_open(file, &rtl_regtrace_seq_ops);
+
+	if (!rc)
+		((struct seq_file *)file->private_data)->private =
+			inode->i_private;
+
+	return rc;
+}
+
+/* any write clears the trace */
+static ssize_t rtl_regtrace_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct rtl8169_private *rtl_p =
+		((struct seq_file *)file->private_data)->private;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&rtl_p->regtrace.lock, flags);
+	rtl_p->regtrace.head = 0;
+	raw_spin_unlock_irqrestore(&rtl_p->regtrace.lock, flags);
+
+	return count;
+}
+
+static const struct file_operations rtl_regtrace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= rtl_regtrace_open,
+	.read		= seq_read,
+	.write		= rtl_regtrace_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static void rtl_regtrace_free(void *data)
+{
+	kvfree(data);
+}
+
+/* before the debugfs dir, devres then frees the buffer after removing it */
+static int rtl_regtrace_init(struct rtl8169_private *rtl_p)
+{
+	struct rtl_regtrace *rt = &rtl_p->regtrace;
+
+	raw_spin_lock_init(&rt->lock);
+	rt->buf = kvcalloc(RTL_REGTRACE_ENTRIES, sizeof(*rt->buf), GFP_KERNEL);
+	if (!rt->buf)
+		return -ENOMEM;
+
+	return devm_add_action_or_reset(tp_to_dev(rtl_p), rtl_regtrace_free,
+					rt->buf);
+}
+
+static void rtl_regtrace_debugfs(struct rtl8169_private *rtl_p,
+				 struct dentry *dir)
+{
+	debugfs_create_file("regtrace", 0600, dir, rtl_p, &rtl_regtrace_fops);
+}
+#else
+static int rtl_regtrace_init(struct rtl8169_private *rtl_p)
+{
+	return 0;
+}
+
+static void rtl_regtrace_debugfs(struct rtl8169_private *rtl_p,
+				 struct dentry *dir)
+{
+}
+#endif
+
+static void rtl_debugfs_remove(void *data)
+{
+	debugfs_remove_recursive(data);
+}
+
+static int rtl_aspm_show(struct seq_file *m, void *v)
+{
+	struct rtl8169_private *rtl_p = m->private;
+
+	seq_printf(m, "dynamic: %d\n", rtl_p->aspm.dynamic);
+	seq_printf(m, "off: %d\n", rtl_p->aspm.off);
+	seq_printf(m, "state: %s\n", rtl_p->aspm.busy ? "busy" : "idle");
+	seq_printf(m, "pps: %u\n", rtl_p->load.pps);
+	seq_printf(m, "to_busy: %u\n", rtl_p->aspm.to_busy);
+	seq_printf(m, "to_idle: %u\n", rtl_p->aspm.to_idle);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rtl_aspm);
+
+static int rtl_addr_to_node(const void *addr)
+{
+	struct page *page;
+
+	if (!addr)
+		return NUMA_NO_NODE;
+
+	page = is_vmalloc_addr(addr) ? vmalloc_to_page(addr) : virt_to_page(addr);
+
+	return page_to_nid(page);
+}
+
+static int rtl_numa_show(struct seq_file *m, void *v)
+{
+	struct rtl8169_private *rtl_p = m->private;
+	int node = dev_to_node(tp_to_dev(rtl_p));
+	const struct cpumask *mask;
+	unsigned int i, local = 0;
+
+	rtnl_lock();
+
+	seq_printf(m, "device: %d\n", node);
+	seq_printf(m, "private: %d\n", rtl_addr_to_node(rtl_p));
+	seq_printf(m, "counters: %d\n", rtl_addr_to_node(rtl_p->counters));
+
+	if (rtl_p->TxDescArray) {
+		seq_printf(m, "tx_ring: %d\n", rtl_addr_to_node(rtl_p->TxDescArray));
+		seq_printf(m, "rx_ring: %d\n", rtl_addr_to_node(rtl_p->RxDescArray));
+		for (i = 0; i < NUM_RX_DESC && rtl_p->Rx_databuff[i]; i++)
+			local += page_to_nid(rtl_p->Rx_databuff[i]) == node;
+		seq_printf(m, "rx_buffers_local: %u of %u\n", local, i);
+	}
+
+	if (netif_running(rtl_p->netdev)) {
+		mask = irq_get_effective_affinity_mask(rtl_p->irq);
+		if (mask)
+			seq_printf(m, "irq %d cpus: %*pbl\n", rtl_p->irq,
+				   cpumask_pr_args(mask));
+		if (node != NUMA_NO_NODE)
+			seq_printf(m, "local cpus: %*pbl\n",
+				   cpumask_pr_args(cpumask_of_node(node)));
+	}
+
+	rtnl_unlock();
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rtl_numa);
+
+static int rtl_eee_show(struct seq_file *m, void *v)
+{
+	struct rtl8169_private *rtl_p = m->private;
+
+	seq_printf(m, "adaptive: %d\n",
+		   !!(rtl_p->priv_flags & RTL_PRIV_FLAG_EEE_ADAPTIVE));
+	seq_printf(m, "tx_lpi: %d\n", rtl_eee_lpi_wanted(rtl_p));
+	seq_printf(m, "state: %s\n", rtl_p->eee.busy ? "busy" : "idle");
+	seq_printf(m, "to_busy: %u\n", rtl_p->eee.to_busy);
+	seq_printf(m, "to_idle: %u\n", rtl_p->eee.to_idle);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rtl_eee);
+
+static int rtl_debugfs_init(struct rtl8169_private *rtl_p)
+{
+	struct pci_dev *pcidev = rtl_p->pcidev;
+	struct dentry *dir;
+	int rc;
+
+	rc = rtl_regtrace_init(rtl_p);
+	if (rc)
+		return rc;
+
+	dir = debugfs_create_dir(pci_name(pcidev), rtl_debugfs_root);
+	rtl_p->debugfs_dir = dir;
+
+	debugfs_create_file("latency", 0400, dir, rtl_p, &rtl_latency_fops);
+	debugfs_create_file("rings", 0400, dir, rtl_p, &rtl_rings_fops);
+	debugfs_create_file("occupancy", 0400, dir, rtl_p, &rtl_occupancy_fops);
+	debugfs_create_file("phy_shadow", 0400, dir, rtl_p, &rtl_phy_shadow_fops);
+	debugfs_create_bool("phy_shadow_verify", 0600, dir,
+			    &rtl_p->phy_shadow.verify);
+	debugfs_create_file("aspm", 0400, dir, rtl_p, &rtl_aspm_fops);
+	debugfs_create_file("eee", 0400, dir, rtl_p, &rtl_eee_fops);
+	debugfs_create_file("numa", 0400, dir, rtl_p, &rtl_numa_fops);
+	rtl_regtrace_debugfs(rtl_p, dir);
+
+	return devm_add_action_or_reset(&pcidev->dev, rtl_debugfs_remove, dir);
+}
+
+enum rtl_devlink_param_id {
+	RTL_DEVLINK_PARAM_ID_BASE = DEVLINK_PARAM_GENERIC_ID_MAX,
+	RTL_DEVLINK_PARAM_ID_ASPM_DYNAMIC,
+	RTL_DEVLINK_PARAM_ID_ASPM_HIGH_PPS,
+	RTL_DEVLINK_PARAM_ID_ASPM_LOW_PPS,
+	RTL_DEVLINK_PARAM_ID_PROFILE,
+	RTL_DEVLINK_PARAM_ID_FIFO_RX_SIZE,
+	RTL_DEVLINK_PARAM_ID_FIFO_TX_SIZE,
+	RTL_DEVLINK_PARAM_ID_PAUSE_LOW_THRESH,
+	RTL_DEVLINK_PARAM_ID_PAUSE_HIGH_THRESH,
+};
+
+static int rtl_profile_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < RTL_PROFILE_MAX; i++)
+		if (!strcmp(name, rtl_profiles[i].name))
+			return i;
+
+	return -EINVAL;
+}
+
+static struct rtl8169_private *rtl_devlink_priv(struct devlink *devlink)
+{
+	return *(struct rtl8169_private **)devlink_priv(devlink);
+}
+
+static int rtl_devlink_param_get(struct devlink *devlink, u32 id,
+				 struct devlink_param_gset_ctx *ctx)
+{
+	struct rtl8169_private *rtl_p = rtl_devlink_priv(devlink);
+
+	switch (id) {
+	case RTL_DEVLINK_PARAM_ID_ASPM_DYNAMIC:
+		ctx->val.vbool = rtl_p->aspm.dynamic;
+		break;
+	case RTL_DEVLINK_PARAM_ID_ASPM_HIGH_PPS:
+		ctx->val.vu32 = rtl_p->aspm.high_pps;
+		break;
+	case RTL_DEVLINK_PARAM_ID_ASPM_LOW_PPS:
+		ctx->val.vu32 = rtl_p->aspm.low_pps;
+		break;
+	case RTL_DEVLINK_PARAM_ID_PROFILE:
+		strscpy(ctx->val.vstr, rtl_profiles[rtl_p->profile].name,
+			sizeof(ctx->val.vstr));
+		break;
+	case RTL_DEVLINK_PARAM_ID_FIFO_RX_SIZE:
+		ctx->val.vu32 = rtl_p->fifo.rx_user ?: rtl_p->fifo.rx_def;
+		break;
+	case RTL_DEVLINK_PARAM_ID_FIFO_TX_SIZE:
+		ctx->val.vu32 = rtl_p->fifo.tx_user ?: rtl_p->fifo.tx_def;
+		break;
+	case RTL_DEVLINK_PARAM_ID_PAUSE_LOW_THRESH:
+		ctx->val.vu32 = rtl_p->fifo.pause_low_user ?: rtl_p->fifo.pause_low_def;
+		break;
+	case RTL_DEVLINK_PARAM_ID_PAUSE_HIGH_THRESH:
+		ctx->val.vu32 = rtl_p->fifo.pause_high_user ?: rtl_p->fifo.pause_high_def;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+static int rtl_devlink_param_set(struct devlink *devlink, u32 id,
+				 struct devlink_param_gset_ctx *ctx)
+{
+	struct rtl8169_private *rtl_p = rtl_devlink_priv(devlink);
+	int rc = 0;
+
+	/* serializes with open, close and the reset task */
+	rtnl_lock();
+
+	switch (id) {
+	case RTL_DEVLINK_PARAM_ID_ASPM_DYNAMIC:
+		rtl_p->aspm.dynamic = ctx->val.vbool;
+		rtl_load_policy_update(rtl_p);
+		break;
+	case RTL_DEVLINK_PARAM_ID_ASPM_HIGH_PPS:
+		WRITE_ONCE(rtl_p->aspm.high_pps, ctx->val.vu32);
+		break;
+	case RTL_DEVLINK_PARAM_ID_ASPM_LOW_PPS:
+		WRITE_ONCE(rtl_p->aspm.low_pps, ctx->val.vu32);
+		break;
+	case RTL_DEVLINK_PARAM_ID_PROFILE:
+		rtl_set_profile(rtl_p, rtl_profile_lookup(ctx->val.vstr));
+		break;
+	case RTL_DEVLINK_PARAM_ID_FIFO_RX_SIZE:
+	case RTL_DEVLINK_PARAM_ID_FIFO_TX_SIZE:
+		if (id == RTL_DEVLINK_PARAM_ID_FIFO_RX_SIZE)
+			rtl_p->fifo.rx_user = ctx->val.vu32;
+		else
+			rtl_p->fifo.tx_user = ctx->val.vu32;
+		/* repartitioning the FIFO needs the chip to be idle */
+		if (test_bit(RTL_FLAG_TASK_ENABLED, rtl_p->wk.flags))
+			rtl_schedule_task(rtl_p, RTL_FLAG_TASK_RESET_PENDING);
+		break;
+	case RTL_DEVLINK_PARAM_ID_PAUSE_LOW_THRESH:
+	case RTL_DEVLINK_PARAM_ID_PAUSE_HIGH_THRESH:
+		if (id == RTL_DEVLINK_PARAM_ID_PAUSE_LOW_THRESH)
+			rtl_p->fifo.pause_low_user = ctx->val.vu32;
+		else
+			rtl_p->fifo.pause_high_user = ctx->val.vu32;
+		if (test_bit(RTL_FLAG_TASK_ENABLED, rtl_p->wk.flags))
+			rtl8168g_set_pause_thresholds(rtl_p);
+		break;
+	default:
+		rc = -EOPNOTSUPP;
+		break;
+	}
+
+	rtnl_unlock();
+
+	return rc;
+}
+
+static int rtl_devlink_param_validate(struct devlink *devlink, u32 id,
+				      union devlink_param_value val,
+				      struct netlink_ext_ack *extack)
+{
+	struct rtl8169_private *rtl_p = rtl_devlink_priv(devlink);
+	u32 size, other;
+
+	switch (id) {
+	case RTL_DEVLINK_PARAM_ID_ASPM_DYNAMIC:
+		if (val.vbool && !rtl_aspm_dynamic_supported(rtl_p)) {
+			NL_SET_ERR_MSG_MOD(extack, "ASPM can't be controlled on this device");
+			return -EOPNOTSUPP;
+		}
+		break;
+	case RTL_DEVLINK_PARAM_ID_ASPM_HIGH_PPS:
+		if (val.vu32 <= READ_ONCE(rtl_p->aspm.low_pps)) {
+			NL_SET_ERR_MSG_MOD(extack, "aspm_high_pps must be above aspm_low_pps");
+			return -EINVAL;
+		}
+		break;
+	case RTL_DEVLINK_PARAM_ID_ASPM_LOW_PPS:
+		if (val.vu32 >= READ_ONCE(rtl_p->aspm.high_pps)) {
+			NL_SET_ERR_MSG_MOD(extack, "aspm_low_pps must be below aspm_high_pps");
+			return -EINVAL;
+		}
+		break;
+	case RTL_DEVLINK_PARAM_ID_PROFILE:
+		if (rtl_profile_lookup(val.vstr) < 0) {
+			NL_SET_ERR_MSG_MOD(extack, "profile must be default, latency, throughput or power");
+			return -EINVAL;
+		}
+		break;
+	case RTL_DEVLINK_PARAM_ID_FIFO_RX_SIZE:
+	case RTL_DEVLINK_PARAM_ID_FIFO_TX_SIZE:
+		if (!rtl_fifo_size_supported(rtl_p)) {
+			NL_SET_ERR_MSG_MOD(extack, "FIFO partitioning isn't supported on this chip");
+			return -EOPNOTSUPP;
+		}
+		/* 0 restores the chip default */
+		if (id == RTL_DEVLINK_PARAM_ID_FIFO_RX_SIZE) {
+			size = val.vu32 ?: rtl_p->fifo.rx_def;
+			other = rtl_p->fifo.tx_user ?: rtl_p->fifo.tx_def;
+		} else {
+			size = val.vu32 ?: rtl_p->fifo.tx_def;
+			other = rtl_p->fifo.rx_user ?: rtl_p->fifo.rx_def;
+		}
+		if (size + other > RTL_FIFO_TOTAL) {
+			NL_SET_ERR_MSG_MOD(extack, "Rx and Tx FIFO sizes exceed the FIFO");
+			return -ERANGE;
+		}
+		break;
+	case RTL_DEVLINK_PARAM_ID_PAUSE_LOW_THRESH:
+	case RTL_DEVLINK_PARAM_ID_PAUSE_HIGH_THRESH:
+		if (!rtl_pause_thresholds_supported(rtl_p)) {
+			NL_SET_ERR_MSG_MOD(extack, "pause thresholds aren't supported on this chip");
+			return -EOPNOTSUPP;
+		}
+		if (val.vu32 > U8_MAX) {
+			NL_SET_ERR_MSG_MOD(extack, "pause thresholds are 8 bit wide");
+			return -ERANGE;
+		}
+		if (id == RTL_DEVLINK_PARAM_ID_PAUSE_LOW_THRESH) {
+			size = val.vu32 ?: rtl_p->fifo.pause_low_def;
+			other = rtl_p->fifo.pause_high_user ?: rtl_p->fifo.pause_high_def;
+			if (other && size >= other) {
+				NL_SET_ERR_MSG_MOD(extack, "pause_low_thresh must be below pause_high_thresh");
+				return -EINVAL;
+			}
+		} else {
+			size = val.vu32 ?: rtl_p->fifo.pause_high_def;
+			other = rtl_p->fifo.pause_low_user ?: rtl_p->fifo.pause_low_def;
+			if (size && size <= other) {
+				NL_SET_ERR_MSG_MOD(extack, "pause_high_thresh must be above pause_low_thresh");
+				return -EINVAL;
+			}
+		}
+		break;
+	}
+
+	return 0;
+}
+
+static const struct devlink_param rtl_devlink_params[] = {
+	DEVLINK_PARAM_DRIVER(RTL_DEVLINK_PARAM_ID_ASPM_DYNAMIC, "aspm_dynamic",
+			     DEVLINK_PARAM_TYPE_BOOL,
+			     BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+			     rtl_devlink_param_get, rtl_devlink_param_set,
+			     rtl_devlink_param_validate),
+	DEVLINK_PARAM_DRIVER(RTL_DEVLINK_PARAM_ID_ASPM_HIGH_PPS, "aspm_high_pps",
+			     DEVLINK_PARAM_TYPE_U32,
+			     BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+			     rtl_devlink_param_get, rtl_devlink_param_set,
+			     rtl_devlink_param_validate),
+	DEVLINK_PARAM_DRIVER(RTL_DEVLINK_PARAM_ID_ASPM_LOW_PPS, "aspm_low_pps",
+			     DEVLINK_PARAM_TYPE_U32,
+			     BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+			     rtl_devlink_param_get, rtl_devlink_param_set,
+			     rtl_devlink_param_validate),
+	DEVLINK_PARAM_DRIVER(RTL_DEVLINK_PARAM_ID_PROFILE, "profile",
+			     DEVLINK_PARAM_TYPE_STRING,
+			     BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+			     rtl_devlink_param_get, rtl_devlink_param_set,
+			     rtl_devlink_param_validate),
+	DEVLINK_PARAM_DRIVER(RTL_DEVLINK_PARAM_ID_FIFO_RX_SIZE, "fifo_rx_size",
+			     DEVLINK_PARAM_TYPE_U32,
+			     BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+			     rtl_devlink_param_get, rtl_devlink_param_set,
+			     rtl_devlink_param_validate),
+	DEVLINK_PARAM_DRIVER(RTL_DEVLINK_PARAM_ID_FIFO_TX_SIZE, "fifo_tx_size",
+			     DEVLINK_PARAM_TYPE_U32,
+			     BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+			     rtl_devlink_param_get, rtl_devlink_param_set,
+			     rtl_devlink_param_validate),
+	DEVLINK_PARAM_DRIVER(RTL_DEVLINK_PARAM_ID_PAUSE_LOW_THRESH, "pause_low_thresh",
+			     DEVLINK_PARAM_TYPE_U32,
+			     BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+			     rtl_devlink_param_get, rtl_devlink_param_set,
+			     rtl_devlink_param_validate),
+	DEVLINK_PARAM_DRIVER(RTL_DEVLINK_PARAM_ID_PAUSE_HIGH_THRESH, "pause_high_thresh",
+			     DEVLINK_PARAM_TYPE_U32,
+			     BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+			     rtl_devlink_param_get, rtl_devlink_param_set,
+			     rtl_devlink_param_validate),
+};
+
+static const struct devlink_ops rtl_devlink_ops = {
+};
+
+static void rtl_devlink_remove(void *data)
+{
+	struct devlink *devlink = data;
+
+	devlink_unregister(devlink);
+	devlink_params_unregister(devlink, rtl_devlink_params,
+				  ARRAY_SIZE(rtl_devlink_params));
+	devlink_free(devlink);
+}
+
+static int rtl_devlink_init(struct rtl8169_private *rtl_p)
+{
+	struct device *d = tp_to_dev(rtl_p);
+	struct devlink *devlink;
+	int rc;
+
+	devlink = devlink_alloc(&rtl_devlink_ops, sizeof(rtl_p), d);
+	if (!devlink)
+		return -ENOMEM;
+
+	*(struct rtl8169_private **)devlink_priv(devlink) = rtl_p;
+
+	rc = devlink_params_register(devlink, rtl_devlink_params,
+				     ARRAY_SIZE(rtl_devlink_params));
+	if (rc) {
+		devlink_free(devlink);
+		return rc;
+	}
+
+	devlink_register(devlink);
+	rtl_p->devlink = devlink;
+
+	return devm_add_action_or_reset(d, rtl_devlink_remove, devlink);
+}
+
+static void rtl_unregister_pool_shrinker(void *data)
+{
+	unregister_shrinker(data);
+}
+
+static int rtl_register_pool_shrinker(struct rtl8169_private *rtl_p)
+{
+	struct shrinker *shrink = &rtl_p->pool_shrinker;
+	int rc;
+
+	shrink->count_objects = rtl_pool_shrink_count;
+	shrink->scan_objects = rtl_pool_shrink_scan;
+	shrink->seeks = DEFAULT_SEEKS;
+
+	rc = register_shrinker(shrink, "r8169-%s", pci_name(rtl_p->pcidev));
+	if (rc)
+		return rc;
+
+	return devm_add_action_or_reset(&rtl_p->pcidev->dev,
+					rtl_unregister_pool_shrinker, shrink);
+}
+
+/* account the time since *t to a probe phase and start the next one */
+static void rtl_probe_phase(struct rtl8169_private *rtl_p,
+			    enum rtl_probe_phase phase, ktime_t *t)
+{
+	ktime_t now = ktime_get();
+
+	rtl_p->probe_us[phase] = ktime_us_delta(now, *t);
+	*t = now;
+}
+
+static int rtl_init_one(struct pci_dev *pcidev, const struct pci_device_id *ent)
+{
+	ktime_t start = ktime_get(), t = start;
+	struct rtl8169_private *rtl_p;
+	int jumbo_max, region, rc;
+	enum mac_version chipset;
+	struct net_device *netdev;
+	u32 txconfig;
+	u16 xid;
+
+	printk(KERN_ALERT "%s() called!\n", __func__);
+	netdev = devm_alloc_etherdev(&pcidev->dev, sizeof (*rtl_p));
+	if (!netdev)
+		return -ENOMEM;
+
+	// set pcidev's dev as netdev's dev.parent (i.e., netdev is a child to pcidev)
+	SET_NETDEV_DEV(netdev, &pcidev->dev);
+
+	netdev->netdev_ops = &rtl_netdev_ops;
+	rtl_p = netdev_priv(netdev);
+	rtl_p->netdev = netdev;
+	rtl_p->pcidev = pcidev;
+	rtl_p->supports_gmii = ent->driver_data == RTL_CFG_NO_GBIT ? 0 : 1;
+	rtl_p->eee_adv = -1;
+	rtl_p->eee.tx_lpi = true;
+	rtl_p->ocp_base = OCP_STD_PHY_BASE;
+
+	raw_spin_lock_init(&rtl_p->cfg9346_usage_lock);
+	raw_spin_lock_init(&rtl_p->config25_lock);
+	raw_spin_lock_init(&rtl_p->mac_ocp_lock);
+	mutex_init(&rtl_p->pool.lock);
+	init_completion(&rtl_p->fw_loaded);
+
+	netdev->tstats = devm_netdev_alloc_pcpu_stats(&pcidev->dev,
+						   struct pcpu_sw_netstats);
+	if (!netdev->tstats)
+		return -ENOMEM;
+
+	rtl_p->sw_stats = devm_alloc_percpu(&pcidev->dev, struct rtl_sw_stats);
+	if (!rtl_p->sw_stats)
+		return -ENOMEM;
+
+	/* Get the *optional* external "ether_clk" used on some boards */
+	rtl_p->clk = devm_clk_get_optional_enabled(&pcidev->dev, "ether_clk");
+	if (IS_ERR(rtl_p->clk))
+		return dev_err_probe(&pcidev->dev, PTR_ERR(rtl_p->clk), "failed to get ether_clk\n");
+
+	/* enable device (incl. PCI PM wakeup and hotplug setup) */
+	rc = pcim_enable_device(pcidev);
+	if (rc < 0)
+		return dev_err_probe(&pcidev->dev, rc, "enable failure\n");
+
+	if (pcim_set_mwi(pcidev) < 0)
+		dev_info(&pcidev->dev, "Mem-Wr-Inval unavailable\n");
+
+	/* use first MMIO region */
 	region = ffs(pci_select_bars(pcidev, IORESOURCE_MEM)) - 1;
 	if (region < 0)
 		return dev_err_probe(&pcidev->dev, -ENODEV, "no MMIO resource found\n");
@@ -5230,6 +8026,7 @@ static int rtl_init_one(struct pci_dev *pcidev, const struct pci_device_id *ent)
 		return dev_err_probe(&pcidev->dev, rc, "cannot remap MMIO, aborting\n");
 
 	rtl_p->mmio_addr = pcim_iomap_table(pcidev)[region];
+	rtl_probe_phase(rtl_p, RTL_PROBE_ENABLE, &t);
 
 	txconfig = RTL_R32(rtl_p, TxConfig);
 	if (txconfig == ~0U)
@@ -5244,6 +8041,7 @@ static int rtl_init_one(struct pci_dev *pcidev, const struct pci_device_id *ent)
 				     "unknown chip XID %03x, contact r8169 maintainers (see MAINTAINERS file)\n",
 				     xid);
 	rtl_p->mac_version = chipset;
+	rtl_fifo_init_defaults(rtl_p);
 
 	/* Disable ASPM L1 as that cause random device stop working
 	 * problems as well as full system hangs for some PCIe devices users.
@@ -5254,9 +8052,18 @@ static int rtl_init_one(struct pci_dev *pcidev, const struct pci_device_id *ent)
 		rc = pci_disable_link_state(pcidev, PCIE_LINK_STATE_L1);
 	rtl_p->aspm_manageable = !rc;
 
+	/* device keeps its internal state when going from D3hot to D0 */
+	if (pcidev->pm_cap) {
+		u16 pmcsr;
+
+		pci_read_config_word(pcidev, pcidev->pm_cap + PCI_PM_CTRL, &pmcsr);
+		rtl_p->rpm.no_soft_reset = !!(pmcsr & PCI_PM_CTRL_NO_SOFT_RESET);
+	}
+
 	rtl_p->dash_type = rtl_check_dash(rtl_p);
 
 	rtl_p->cp_cmd = RTL_R16(rtl_p, CPlusCmd) & CPCMD_MASK;
+	rtl_probe_phase(rtl_p, RTL_PROBE_DETECT, &t);
 
 	if (sizeof(dma_addr_t) > 4 && rtl_p->mac_version >= RTL_GIGA_MAC_VER_18 &&
 	    !dma_set_mask_and_coherent(&pcidev->dev, DMA_BIT_MASK(64)))
@@ -5269,6 +8076,7 @@ static int rtl_init_one(struct pci_dev *pcidev, const struct pci_device_id *ent)
 	rtl_hw_initialize(rtl_p);
 
 	rtl_hw_reset(rtl_p);
+	rtl_probe_phase(rtl_p, RTL_PROBE_HW_INIT, &t);
 
 	rc = rtl_alloc_irq(rtl_p);
 	if (rc < 0)
@@ -5277,6 +8085,9 @@ static int rtl_init_one(struct pci_dev *pcidev, const struct pci_device_id *ent)
 	rtl_p->irq = pci_irq_vector(pcidev, 0);
 
 	INIT_WORK(&rtl_p->wk.work, rtl_task);
+	INIT_DELAYED_WORK(&rtl_p->load.work, rtl_load_work);
+	rtl_p->aspm.high_pps = RTL_ASPM_HIGH_PPS;
+	rtl_p->aspm.low_pps = RTL_ASPM_LOW_PPS;
 
 	rtl_init_mac_address(rtl_p);
 
@@ -5348,13 +8159,33 @@ static int rtl_init_one(struct pci_dev *pcidev, const struct pci_device_id *ent)
 
 	pci_set_drvdata(pcidev, rtl_p);
 
+	rc = rtl_register_pool_shrinker(rtl_p);
+	if (rc)
+		return rc;
+
+	rc = rtl_debugfs_init(rtl_p);
+	if (rc)
+		return rc;
+
+	rc = rtl_devlink_init(rtl_p);
+	if (rc)
+		return rc;
+	rtl_probe_phase(rtl_p, RTL_PROBE_SETUP, &t);
+
 	rc = r8169_mdio_register(rtl_p);
 	if (rc)
 		return rc;
+	rtl_probe_phase(rtl_p, RTL_PROBE_MDIO, &t);
+
+	rtl_request_firmware(rtl_p);
 
 	rc = register_netdev(netdev);
-	if (rc)
+	if (rc) {
+		rtl_release_firmware(rtl_p);
 		return rc;
+	}
+	rtl_probe_phase(rtl_p, RTL_PROBE_REGISTER, &t);
+	rtl_p->probe_total_us = ktime_us_delta(t, start);
 
 	netdev_info(netdev, "%s, %pM, XID %03x, IRQ %d\n",
 		    rtl_chip_infos[chipset].name, netdev->dev_addr, xid, rtl_p->irq);
@@ -5369,12 +8200,92 @@ static int rtl_init_one(struct pci_dev *pcidev, const struct pci_device_id *ent)
 		rtl8168_driver_start(rtl_p);
 	}
 
+	/* restored after a slot reset by the PCI error recovery */
+	pci_save_state(pcidev);
+
 	if (pci_dev_run_wake(pcidev))
 		pm_runtime_put_sync(&pcidev->dev);
 
 	return 0;
 }
 
+static pci_ers_result_t rtl_pci_error_detected(struct pci_dev *pcidev,
+					       pci_channel_state_t state)
+{
+	struct rtl8169_private *rtl_p = pci_get_drvdata(pcidev);
+
+	rtl_p->aer.errors++;
+	if (state == pci_channel_io_perm_failure)
+		return PCI_ERS_RESULT_DISCONNECT;
+
+	rtnl_lock();
+	rtl_p->aer.start = ktime_get();
+	netif_device_detach(rtl_p->netdev);
+
+	/*
+	 * The chip may not respond anymore, so only the software side is
+	 * stopped. Rings and Rx buffers stay as they are.
+	 */
+	rtl_p->aer.quiesced = test_bit(RTL_FLAG_TASK_ENABLED, rtl_p->wk.flags);
+	if (rtl_p->aer.quiesced) {
+		bitmap_zero(rtl_p->wk.flags, RTL_FLAG_MAX);
+		rtl_load_policy_stop(rtl_p);
+		rtl_p->aspm.busy = rtl_p->aspm.off;
+		rtl_p->eee.busy = false;
+		phy_stop(rtl_p->phydev);
+		napi_disable(&rtl_p->napi);
+		synchronize_net();
+	}
+	rtnl_unlock();
+
+	return PCI_ERS_RESULT_NEED_RESET;
+}
+
+static pci_ers_result_t rtl_pci_slot_reset(struct pci_dev *pcidev)
+{
+	struct rtl8169_private *rtl_p = pci_get_drvdata(pcidev);
+
+	pci_restore_state(pcidev);
+	pci_save_state(pcidev);
+
+	if (RTL_R32(rtl_p, TxConfig) == ~0) {
+		netdev_err(rtl_p->netdev, "chip not accessible after slot reset\n");
+		return PCI_ERS_RESULT_DISCONNECT;
+	}
+
+	return PCI_ERS_RESULT_RECOVERED;
+}
+
+static void rtl_pci_resume(struct pci_dev *pcidev)
+{
+	struct rtl8169_private *rtl_p = pci_get_drvdata(pcidev);
+
+	rtnl_lock();
+	rtl_hw_initialize(rtl_p);
+	rtl_rar_set(rtl_p, rtl_p->netdev->dev_addr);
+	__rtl8169_set_wol(rtl_p, rtl_p->saved_wolopts);
+
+	if (rtl_p->aer.quiesced) {
+		/* the chip lost its context, PHY config is redone if needed */
+		rtl_p->rpm.snap_valid = false;
+		rtl8169_up(rtl_p, true, false);
+		rtl_p->aer.quiesced = false;
+	}
+
+	netif_device_attach(rtl_p->netdev);
+	rtl_p->aer.recover_us = ktime_us_delta(ktime_get(), rtl_p->aer.start);
+	rtl_p->aer.recoveries++;
+	netdev_info(rtl_p->netdev, "recovered from PCI error in %lld us\n",
+		    rtl_p->aer.recover_us);
+	rtnl_unlock();
+}
+
+static const struct pci_error_handlers rtl8169_err_handler = {
+	.error_detected	= rtl_pci_error_detected,
+	.slot_reset	= rtl_pci_slot_reset,
+	.resume		= rtl_pci_resume,
+};
+
 static struct pci_driver rtl8169_pci_driver = {
 	.name		= KBUILD_MODNAME,
 	.id_table	= rtl8169_pci_tbl,
@@ -5382,6 +8293,32 @@ static struct pci_driver rtl8169_pci_driver = {
 	.remove		= rtl_remove_one,
 	.shutdown	= rtl_shutdown,
 	.driver.pm	= pm_ptr(&rtl8169_pm_ops),
+	.err_handler	= &rtl8169_err_handler,
+	/* ports probe in parallel, off the boot path */
+	.driver.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 };
 
-module_pci_driver(rtl8169_pci_driver);
+static int __init rtl8169_init_module(void)
+{
+	int rc;
+
+	rtl_debugfs_root = debugfs_create_dir(KBUILD_MODNAME, NULL);
+	debugfs_create_file("cond_wait", 0400, rtl_debugfs_root, NULL,
+			    &rtl_cond_wait_fops);
+	debugfs_create_u32("cond_spin_max_ns", 0600, rtl_debugfs_root,
+			   &rtl_cond_spin_max_ns);
+
+	rc = pci_register_driver(&rtl8169_pci_driver);
+	if (rc)
+		debugfs_remove_recursive(rtl_debugfs_root);
+
+	return rc;
+}
+module_init(rtl8169_init_module);
+
+static void __exit rtl8169_cleanup_module(void)
+{
+	pci_unregister_driver(&rtl8169_pci_driver);
+	debugfs_remove_recursive(rtl_debugfs_root);
+}
+module_exit(rtl8169_cleanup_module);
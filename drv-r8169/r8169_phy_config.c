@@ -70,6 +70,49 @@ static void __rtl_writephy_batch(struct phy_device *phydev,
 
 #define rtl_writephy_batch(p, a) __rtl_writephy_batch(p, a, ARRAY_SIZE(a))
 
+/* Paged PHY script, a mask of 0xffff is a plain write without the read */
+struct phy_cmd {
+	u16 page;
+	u16 reg;
+	u16 mask;
+	u16 val;
+};
+
+#define PHY_PARAM(parm, mask, val) \
+	{ 0x0a43, 0x13, 0xffff, parm }, { 0x0a43, 0x14, mask, val }
+
+/*
+ * Run the whole table under a single bus lock and only switch pages when the
+ * page changes, instead of a select/restore pair for every access. Registers
+ * are never merged, 0x14 and friends are auto-incrementing data ports.
+ */
+static void __rtl_phy_script(struct phy_device *phydev,
+			     const struct phy_cmd *cmd, int len)
+{
+	int page = -1;
+
+	phy_lock_mdio_bus(phydev);
+
+	for (; len > 0; len--, cmd++) {
+		if (cmd->page != page) {
+			page = cmd->page;
+			__phy_write(phydev, 0x1f, page);
+		}
+
+		if (cmd->mask == 0xffff)
+			__phy_write(phydev, cmd->reg, cmd->val);
+		else
+			__phy_modify(phydev, cmd->reg, cmd->mask, cmd->val);
+	}
+
+	if (page)
+		__phy_write(phydev, 0x1f, 0x0000);
+
+	phy_unlock_mdio_bus(phydev);
+}
+
+#define rtl_phy_script(p, a) __rtl_phy_script(p, a, ARRAY_SIZE(a))
+
 static void rtl8168f_config_eee_phy(struct phy_device *phydev)
 {
 	r8168d_modify_extpage(phydev, 0x0020, 0x15, 0, BIT(8));
@@ -836,6 +879,30 @@ static void rtl8168h_2_hw_phy_config(struct rtl8169_private *rtl_p,
 static void rtl8168ep_2_hw_phy_config(struct rtl8169_private *rtl_p,
 				      struct phy_device *phydev)
 {
+	static const struct phy_cmd chn_est_params[] = {
+		PHY_PARAM(0x80f3, 0xff00, 0x8b00),
+		PHY_PARAM(0x80f0, 0xff00, 0x3a00),
+		PHY_PARAM(0x80ef, 0xff00, 0x0500),
+		PHY_PARAM(0x80f6, 0xff00, 0x6e00),
+		PHY_PARAM(0x80ec, 0xff00, 0x6800),
+		PHY_PARAM(0x80ed, 0xff00, 0x7c00),
+		PHY_PARAM(0x80f2, 0xff00, 0xf400),
+		PHY_PARAM(0x80f4, 0xff00, 0x8500),
+		PHY_PARAM(0x8110, 0xff00, 0xa800),
+		PHY_PARAM(0x810f, 0xff00, 0x1d00),
+		PHY_PARAM(0x8111, 0xff00, 0xf500),
+		PHY_PARAM(0x8113, 0xff00, 0x6100),
+		PHY_PARAM(0x8115, 0xff00, 0x9200),
+		PHY_PARAM(0x810e, 0xff00, 0x0400),
+		PHY_PARAM(0x810c, 0xff00, 0x7c00),
+		PHY_PARAM(0x810b, 0xff00, 0x5a00),
+		PHY_PARAM(0x80d1, 0xff00, 0xff00),
+		PHY_PARAM(0x80cd, 0xff00, 0x9e00),
+		PHY_PARAM(0x80d3, 0xff00, 0x0e00),
+		PHY_PARAM(0x80d5, 0xff00, 0xca00),
+		PHY_PARAM(0x80d7, 0xff00, 0x8400),
+	};
+
 	rtl8168g_phy_adjust_10m_aldps(phydev);
 
 	/* Enable UC LPF tune function */
@@ -845,27 +912,7 @@ static void rtl8168ep_2_hw_phy_config(struct rtl8169_private *rtl_p,
 	phy_modify_paged(phydev, 0x0c42, 0x11, BIT(13), BIT(14));
 
 	/* Channel estimation parameters */
-	r8168g_phy_param(phydev, 0x80f3, 0xff00, 0x8b00);
-	r8168g_phy_param(phydev, 0x80f0, 0xff00, 0x3a00);
-	r8168g_phy_param(phydev, 0x80ef, 0xff00, 0x0500);
-	r8168g_phy_param(phydev, 0x80f6, 0xff00, 0x6e00);
-	r8168g_phy_param(phydev, 0x80ec, 0xff00, 0x6800);
-	r8168g_phy_param(phydev, 0x80ed, 0xff00, 0x7c00);
-	r8168g_phy_param(phydev, 0x80f2, 0xff00, 0xf400);
-	r8168g_phy_param(phydev, 0x80f4, 0xff00, 0x8500);
-	r8168g_phy_param(phydev, 0x8110, 0xff00, 0xa800);
-	r8168g_phy_param(phydev, 0x810f, 0xff00, 0x1d00);
-	r8168g_phy_param(phydev, 0x8111, 0xff00, 0xf500);
-	r8168g_phy_param(phydev, 0x8113, 0xff00, 0x6100);
-	r8168g_phy_param(phydev, 0x8115, 0xff00, 0x9200);
-	r8168g_phy_param(phydev, 0x810e, 0xff00, 0x0400);
-	r8168g_phy_param(phydev, 0x810c, 0xff00, 0x7c00);
-	r8168g_phy_param(phydev, 0x810b, 0xff00, 0x5a00);
-	r8168g_phy_param(phydev, 0x80d1, 0xff00, 0xff00);
-	r8168g_phy_param(phydev, 0x80cd, 0xff00, 0x9e00);
-	r8168g_phy_param(phydev, 0x80d3, 0xff00, 0x0e00);
-	r8168g_phy_param(phydev, 0x80d5, 0xff00, 0xca00);
-	r8168g_phy_param(phydev, 0x80d7, 0xff00, 0x8400);
+	rtl_phy_script(phydev, chn_est_params);
 
 	/* Force PWM-mode */
 	phy_write(phydev, 0x1f, 0x0bcd);
@@ -886,29 +933,33 @@ static void rtl8168ep_2_hw_phy_config(struct rtl8169_private *rtl_p,
 static void rtl8117_hw_phy_config(struct rtl8169_private *rtl_p,
 				  struct phy_device *phydev)
 {
+	static const struct phy_cmd chn_est_params[] = {
+		PHY_PARAM(0x808e, 0xff00, 0x4800),
+		PHY_PARAM(0x8090, 0xff00, 0xcc00),
+		PHY_PARAM(0x8092, 0xff00, 0xb000),
+
+		PHY_PARAM(0x8088, 0xff00, 0x6000),
+		PHY_PARAM(0x808b, 0x3f00, 0x0b00),
+		PHY_PARAM(0x808d, 0x1f00, 0x0600),
+		PHY_PARAM(0x808c, 0xff00, 0xb000),
+		PHY_PARAM(0x80a0, 0xff00, 0x2800),
+		PHY_PARAM(0x80a2, 0xff00, 0x5000),
+		PHY_PARAM(0x809b, 0xf800, 0xb000),
+		PHY_PARAM(0x809a, 0xff00, 0x4b00),
+		PHY_PARAM(0x809d, 0x3f00, 0x0800),
+		PHY_PARAM(0x80a1, 0xff00, 0x7000),
+		PHY_PARAM(0x809f, 0x1f00, 0x0300),
+		PHY_PARAM(0x809e, 0xff00, 0x8800),
+		PHY_PARAM(0x80b2, 0xff00, 0x2200),
+		PHY_PARAM(0x80ad, 0xf800, 0x9800),
+		PHY_PARAM(0x80af, 0x3f00, 0x0800),
+		PHY_PARAM(0x80b3, 0xff00, 0x6f00),
+		PHY_PARAM(0x80b1, 0x1f00, 0x0300),
+		PHY_PARAM(0x80b0, 0xff00, 0x9300),
+	};
+
 	/* CHN EST parameters adjust - fnet */
-	r8168g_phy_param(phydev, 0x808e, 0xff00, 0x4800);
-	r8168g_phy_param(phydev, 0x8090, 0xff00, 0xcc00);
-	r8168g_phy_param(phydev, 0x8092, 0xff00, 0xb000);
-
-	r8168g_phy_param(phydev, 0x8088, 0xff00, 0x6000);
-	r8168g_phy_param(phydev, 0x808b, 0x3f00, 0x0b00);
-	r8168g_phy_param(phydev, 0x808d, 0x1f00, 0x0600);
-	r8168g_phy_param(phydev, 0x808c, 0xff00, 0xb000);
-	r8168g_phy_param(phydev, 0x80a0, 0xff00, 0x2800);
-	r8168g_phy_param(phydev, 0x80a2, 0xff00, 0x5000);
-	r8168g_phy_param(phydev, 0x809b, 0xf800, 0xb000);
-	r8168g_phy_param(phydev, 0x809a, 0xff00, 0x4b00);
-	r8168g_phy_param(phydev, 0x809d, 0x3f00, 0x0800);
-	r8168g_phy_param(phydev, 0x80a1, 0xff00, 0x7000);
-	r8168g_phy_param(phydev, 0x809f, 0x1f00, 0x0300);
-	r8168g_phy_param(phydev, 0x809e, 0xff00, 0x8800);
-	r8168g_phy_param(phydev, 0x80b2, 0xff00, 0x2200);
-	r8168g_phy_param(phydev, 0x80ad, 0xf800, 0x9800);
-	r8168g_phy_param(phydev, 0x80af, 0x3f00, 0x0800);
-	r8168g_phy_param(phydev, 0x80b3, 0xff00, 0x6f00);
-	r8168g_phy_param(phydev, 0x80b1, 0x1f00, 0x0300);
-	r8168g_phy_param(phydev, 0x80b0, 0xff00, 0x9300);
+	rtl_phy_script(phydev, chn_est_params);
 
 	r8168g_phy_param(phydev, 0x8011, 0x0000, 0x0800);
 
@@ -1001,27 +1052,39 @@ static void rtl8125_legacy_force_mode(struct phy_device *phydev)
 static void rtl8125a_2_hw_phy_config(struct rtl8169_private *rtl_p,
 				     struct phy_device *phydev)
 {
+	static const struct phy_cmd init[] = {
+		{ 0x0ad4, 0x17, 0x0000, 0x0010 },
+		{ 0x0ad1, 0x13, 0x03ff, 0x03ff },
+		{ 0x0ad3, 0x11, 0x003f, 0x0006 },
+		{ 0x0ac0, 0x14, 0x1100, 0x0000 },
+		{ 0x0acc, 0x10, 0x0003, 0x0002 },
+		{ 0x0ad4, 0x10, 0x00e7, 0x0044 },
+		{ 0x0ac1, 0x12, 0x0080, 0x0000 },
+		{ 0x0ac8, 0x10, 0x0300, 0x0000 },
+		{ 0x0ac5, 0x17, 0x0007, 0x0002 },
+		{ 0x0ad4, 0x16, 0xffff, 0x00a8 },
+		{ 0x0ac5, 0x16, 0xffff, 0x01ff },
+		{ 0x0ac8, 0x15, 0x00f0, 0x0030 },
+
+		{ 0x0b87, 0x16, 0xffff, 0x80a2 },
+		{ 0x0b87, 0x17, 0xffff, 0x0153 },
+		{ 0x0b87, 0x16, 0xffff, 0x809c },
+		{ 0x0b87, 0x17, 0xffff, 0x0153 },
+	};
+	static const struct phy_cmd tail[] = {
+		{ 0x0d06, 0x14, 0x0000, 0x2000 },
+
+		PHY_PARAM(0x81a2, 0x0000, 0x0100),
+
+		{ 0x0b54, 0x16, 0xff00, 0xdb00 },
+		{ 0x0a45, 0x12, 0x0001, 0x0000 },
+		{ 0x0a5d, 0x12, 0x0000, 0x0020 },
+		{ 0x0ad4, 0x17, 0x0010, 0x0000 },
+		{ 0x0a86, 0x15, 0x0001, 0x0000 },
+	};
 	int i;
 
-	phy_modify_paged(phydev, 0xad4, 0x17, 0x0000, 0x0010);
-	phy_modify_paged(phydev, 0xad1, 0x13, 0x03ff, 0x03ff);
-	phy_modify_paged(phydev, 0xad3, 0x11, 0x003f, 0x0006);
-	phy_modify_paged(phydev, 0xac0, 0x14, 0x1100, 0x0000);
-	phy_modify_paged(phydev, 0xacc, 0x10, 0x0003, 0x0002);
-	phy_modify_paged(phydev, 0xad4, 0x10, 0x00e7, 0x0044);
-	phy_modify_paged(phydev, 0xac1, 0x12, 0x0080, 0x0000);
-	phy_modify_paged(phydev, 0xac8, 0x10, 0x0300, 0x0000);
-	phy_modify_paged(phydev, 0xac5, 0x17, 0x0007, 0x0002);
-	phy_write_paged(phydev, 0xad4, 0x16, 0x00a8);
-	phy_write_paged(phydev, 0xac5, 0x16, 0x01ff);
-	phy_modify_paged(phydev, 0xac8, 0x15, 0x00f0, 0x0030);
-
-	phy_write(phydev, 0x1f, 0x0b87);
-	phy_write(phydev, 0x16, 0x80a2);
-	phy_write(phydev, 0x17, 0x0153);
-	phy_write(phydev, 0x16, 0x809c);
-	phy_write(phydev, 0x17, 0x0153);
-	phy_write(phydev, 0x1f, 0x0000);
+	rtl_phy_script(phydev, init);
 
 	phy_write(phydev, 0x1f, 0x0a43);
 	phy_write(phydev, 0x13, 0x81B3);
@@ -1049,15 +1112,7 @@ static void rtl8125a_2_hw_phy_config(struct rtl8169_private *rtl_p,
 
 	r8169_apply_firmware(rtl_p);
 
-	phy_modify_paged(phydev, 0xd06, 0x14, 0x0000, 0x2000);
-
-	r8168g_phy_param(phydev, 0x81a2, 0x0000, 0x0100);
-
-	phy_modify_paged(phydev, 0xb54, 0x16, 0xff00, 0xdb00);
-	phy_modify_paged(phydev, 0xa45, 0x12, 0x0001, 0x0000);
-	phy_modify_paged(phydev, 0xa5d, 0x12, 0x0000, 0x0020);
-	phy_modify_paged(phydev, 0xad4, 0x17, 0x0010, 0x0000);
-	phy_modify_paged(phydev, 0xa86, 0x15, 0x0001, 0x0000);
+	rtl_phy_script(phydev, tail);
 	rtl8168g_enable_gphy_10m(phydev);
 
 	rtl8125a_config_eee_phy(phydev);
@@ -1066,37 +1121,39 @@ static void rtl8125a_2_hw_phy_config(struct rtl8169_private *rtl_p,
 static void rtl8125b_hw_phy_config(struct rtl8169_private *rtl_p,
 				   struct phy_device *phydev)
 {
-	r8169_apply_firmware(rtl_p);
+	static const struct phy_cmd init[] = {
+		{ 0x0a44, 0x11, 0x0000, 0x0800 },
+		{ 0x0ac4, 0x13, 0x00f0, 0x0090 },
+		{ 0x0ad3, 0x10, 0x0003, 0x0001 },
+
+		{ 0x0b87, 0x16, 0xffff, 0x80f5 },
+		{ 0x0b87, 0x17, 0xffff, 0x760e },
+		{ 0x0b87, 0x16, 0xffff, 0x8107 },
+		{ 0x0b87, 0x17, 0xffff, 0x360e },
+		{ 0x0b87, 0x16, 0xffff, 0x8551 },
+		{ 0x0b87, 0x17, 0xff00, 0x0800 },
+
+		{ 0x0bf0, 0x10, 0xe000, 0xa000 },
+		{ 0x0bf4, 0x13, 0x0f00, 0x0300 },
+
+		PHY_PARAM(0x8044, 0xffff, 0x2417),
+		PHY_PARAM(0x804a, 0xffff, 0x2417),
+		PHY_PARAM(0x8050, 0xffff, 0x2417),
+		PHY_PARAM(0x8056, 0xffff, 0x2417),
+		PHY_PARAM(0x805c, 0xffff, 0x2417),
+		PHY_PARAM(0x8062, 0xffff, 0x2417),
+		PHY_PARAM(0x8068, 0xffff, 0x2417),
+		PHY_PARAM(0x806e, 0xffff, 0x2417),
+		PHY_PARAM(0x8074, 0xffff, 0x2417),
+		PHY_PARAM(0x807a, 0xffff, 0x2417),
+
+		{ 0x0a4c, 0x15, 0x0000, 0x0040 },
+		{ 0x0bf8, 0x12, 0xe000, 0xa000 },
+	};
 
-	phy_modify_paged(phydev, 0xa44, 0x11, 0x0000, 0x0800);
-	phy_modify_paged(phydev, 0xac4, 0x13, 0x00f0, 0x0090);
-	phy_modify_paged(phydev, 0xad3, 0x10, 0x0003, 0x0001);
-
-	phy_write(phydev, 0x1f, 0x0b87);
-	phy_write(phydev, 0x16, 0x80f5);
-	phy_write(phydev, 0x17, 0x760e);
-	phy_write(phydev, 0x16, 0x8107);
-	phy_write(phydev, 0x17, 0x360e);
-	phy_write(phydev, 0x16, 0x8551);
-	phy_modify(phydev, 0x17, 0xff00, 0x0800);
-	phy_write(phydev, 0x1f, 0x0000);
+	r8169_apply_firmware(rtl_p);
 
-	phy_modify_paged(phydev, 0xbf0, 0x10, 0xe000, 0xa000);
-	phy_modify_paged(phydev, 0xbf4, 0x13, 0x0f00, 0x0300);
-
-	r8168g_phy_param(phydev, 0x8044, 0xffff, 0x2417);
-	r8168g_phy_param(phydev, 0x804a, 0xffff, 0x2417);
-	r8168g_phy_param(phydev, 0x8050, 0xffff, 0x2417);
-	r8168g_phy_param(phydev, 0x8056, 0xffff, 0x2417);
-	r8168g_phy_param(phydev, 0x805c, 0xffff, 0x2417);
-	r8168g_phy_param(phydev, 0x8062, 0xffff, 0x2417);
-	r8168g_phy_param(phydev, 0x8068, 0xffff, 0x2417);
-	r8168g_phy_param(phydev, 0x806e, 0xffff, 0x2417);
-	r8168g_phy_param(phydev, 0x8074, 0xffff, 0x2417);
-	r8168g_phy_param(phydev, 0x807a, 0xffff, 0x2417);
-
-	phy_modify_paged(phydev, 0xa4c, 0x15, 0x0000, 0x0040);
-	phy_modify_paged(phydev, 0xbf8, 0x12, 0xe000, 0xa000);
+	rtl_phy_script(phydev, init);
 
 	rtl8125_legacy_force_mode(phydev);
 	rtl8125b_config_eee_phy(phydev);
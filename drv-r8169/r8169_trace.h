@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/* r8169_trace.h: RealTek 8169/8168/8101 ethernet driver.
+ *
+ * Trace events for the Tx/Rx descriptor lifecycle.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM r8169
+
+#if !defined(_R8169_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _R8169_TRACE_H
+
+#include <linux/netdevice.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(r8169_xmit,
+	TP_PROTO(const struct net_device *netdev, const struct sk_buff *skb,
+		 unsigned int entry, unsigned int frags),
+
+	TP_ARGS(netdev, skb, entry, frags),
+
+	TP_STRUCT__entry(
+		__string(devname, netdev->name)
+		__field(const void *, skbaddr)
+		__field(unsigned int, len)
+		__field(unsigned int, entry)
+		__field(unsigned int, frags)
+	),
+
+	TP_fast_assign(
+		__assign_str(devname, netdev->name);
+		__entry->skbaddr = skb;
+		__entry->len = skb->len;
+		__entry->entry = entry;
+		__entry->frags = frags;
+	),
+
+	TP_printk("dev=%s skbaddr=%p len=%u entry=%u frags=%u",
+		  __get_str(devname), __entry->skbaddr, __entry->len,
+		  __entry->entry, __entry->frags)
+);
+
+TRACE_EVENT(r8169_doorbell,
+	TP_PROTO(const struct net_device *netdev, u32 cur_tx),
+
+	TP_ARGS(netdev, cur_tx),
+
+	TP_STRUCT__entry(
+		__string(devname, netdev->name)
+		__field(u32, cur_tx)
+	),
+
+	TP_fast_assign(
+		__assign_str(devname, netdev->name);
+		__entry->cur_tx = cur_tx;
+	),
+
+	TP_printk("dev=%s cur_tx=%u", __get_str(devname), __entry->cur_tx)
+);
+
+TRACE_EVENT(r8169_tx_complete,
+	TP_PROTO(const struct net_device *netdev, unsigned int pkts,
+		 unsigned int bytes, u32 dirty_tx),
+
+	TP_ARGS(netdev, pkts, bytes, dirty_tx),
+
+	TP_STRUCT__entry(
+		__string(devname, netdev->name)
+		__field(unsigned int, pkts)
+		__field(unsigned int, bytes)
+		__field(u32, dirty_tx)
+	),
+
+	TP_fast_assign(
+		__assign_str(devname, netdev->name);
+		__entry->pkts = pkts;
+		__entry->bytes = bytes;
+		__entry->dirty_tx = dirty_tx;
+	),
+
+	TP_printk("dev=%s pkts=%u bytes=%u dirty_tx=%u", __get_str(devname),
+		  __entry->pkts, __entry->bytes, __entry->dirty_tx)
+);
+
+TRACE_EVENT(r8169_irq,
+	TP_PROTO(const struct net_device *netdev, u32 status),
+
+	TP_ARGS(netdev, status),
+
+	TP_STRUCT__entry(
+		__string(devname, netdev->name)
+		__field(u32, status)
+	),
+
+	TP_fast_assign(
+		__assign_str(devname, netdev->name);
+		__entry->status = status;
+	),
+
+	TP_printk("dev=%s status=0x%08x", __get_str(devname), __entry->status)
+);
+
+TRACE_EVENT(r8169_napi_poll,
+	TP_PROTO(const struct net_device *netdev, int work_done, int budget),
+
+	TP_ARGS(netdev, work_done, budget),
+
+	TP_STRUCT__entry(
+		__string(devname, netdev->name)
+		__field(int, work_done)
+		__field(int, budget)
+	),
+
+	TP_fast_assign(
+		__assign_str(devname, netdev->name);
+		__entry->work_done = work_done;
+		__entry->budget = budget;
+	),
+
+	TP_printk("dev=%s work_done=%d budget=%d", __get_str(devname),
+		  __entry->work_done, __entry->budget)
+);
+
+TRACE_EVENT(r8169_rx,
+	TP_PROTO(const struct net_device *netdev, unsigned int entry, u32 status,
+		 unsigned int len),
+
+	TP_ARGS(netdev, entry, status, len),
+
+	TP_STRUCT__entry(
+		__string(devname, netdev->name)
+		__field(unsigned int, entry)
+		__field(u32, status)
+		__field(unsigned int, len)
+	),
+
+	TP_fast_assign(
+		__assign_str(devname, netdev->name);
+		__entry->entry = entry;
+		__entry->status = status;
+		__entry->len = len;
+	),
+
+	TP_printk("dev=%s entry=%u status=0x%08x len=%u", __get_str(devname),
+		  __entry->entry, __entry->status, __entry->len)
+);
+
+#endif /* _R8169_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE r8169_trace
+#include <trace/define_trace.h>
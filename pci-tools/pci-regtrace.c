@@ -0,0 +1,293 @@
+/* This file analyzes the register trace recorded by the my-r8169 driver when
+ * it is built with R8169_REGTRACE=1 (debugfs file <pci-id>/regtrace).
+ *
+ * Each line of the trace is "<phase> <space> <R|W|B> <addr> <val> <aux>",
+ * where aux is the PHY page or the ERI byte enables and a 'B' line marks the
+ * start of a hw_start or phy_config run. Register values are only assumed
+ * known within a run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// local file includes
+#include "pci-regtrace.h"
+
+// macros
+#define RT_DEBUGFS_DIR		"/sys/kernel/debug/my_r8169/0000:"
+#define RT_MAX_PHASES		(4)
+#define RT_MAX_REGS		(4096)
+#define RT_NAME_LEN		(16)
+#define RT_TOP_REGS		(10)
+
+static const char *RtSpaces[] = {
+	"mmio8", "mmio16", "mmio32", "eri", "mac_ocp", "phy", "ephy"
+};
+#define RT_MAX_SPACES		(sizeof(RtSpaces) / sizeof(RtSpaces[0]))
+
+typedef struct {
+	int space;
+	unsigned int page;	// PHY page, 0 for the other spaces
+	unsigned int addr;
+	unsigned int val;
+	unsigned int known;	// bits of val that are known in this run
+	unsigned int redundant;
+	int phase;
+} rt_reg_t;
+
+typedef struct {
+	unsigned int reads;
+	unsigned int writes;
+	unsigned int redundant;		// write of the value already there
+	unsigned int noop_rmw;		// read-modify-write that changed nothing
+	unsigned int coalescible;	// read right after a write of the register
+	unsigned int back2back;		// write right after a write of the register
+} rt_stats_t;
+
+typedef struct {
+	int reg;		// index into regs[], -1 if none
+	char op;
+	unsigned int val;
+} rt_access_t;
+
+typedef struct {
+	char chip[64];
+	unsigned int recorded;
+	unsigned int lost;
+	char phases[RT_MAX_PHASES][RT_NAME_LEN];
+	int nphases;
+	rt_stats_t stats[RT_MAX_PHASES][RT_MAX_SPACES];
+	rt_reg_t regs[RT_MAX_REGS];
+	int nregs;
+} rt_trace_t;
+
+
+static int rt_space_index(const char *name) {
+	for (int i = 0; i < RT_MAX_SPACES; i++) {
+		if (!strcmp(name, RtSpaces[i]))
+			return i;
+	}
+
+	return -1;
+}
+
+
+static int rt_phase_index(rt_trace_t *rt, const char *name) {
+	for (int i = 0; i < rt->nphases; i++) {
+		if (!strcmp(name, rt->phases[i]))
+			return i;
+	}
+
+	if (rt->nphases == RT_MAX_PHASES)
+		return -1;
+
+	strncpy(rt->phases[rt->nphases], name, RT_NAME_LEN - 1);
+	return rt->nphases++;
+}
+
+
+static int rt_reg_index(rt_trace_t *rt, int space, unsigned int page, unsigned int addr) {
+	for (int i = 0; i < rt->nregs; i++) {
+		rt_reg_t *r = &rt->regs[i];
+
+		if (r->space == space && r->page == page && r->addr == addr)
+			return i;
+	}
+
+	if (rt->nregs == RT_MAX_REGS)
+		return -1;
+
+	memset(&rt->regs[rt->nregs], 0, sizeof(rt_reg_t));
+	rt->regs[rt->nregs].space = space;
+	rt->regs[rt->nregs].page = page;
+	rt->regs[rt->nregs].addr = addr;
+	return rt->nregs++;
+}
+
+
+// bits covered by an access: ERI writes only touch the enabled bytes
+static unsigned int rt_access_mask(int space, char op, unsigned int aux) {
+	unsigned int mask = 0;
+
+	if (strcmp(RtSpaces[space], "eri") || op != 'W')
+		return 0xffffffff;
+
+	for (int i = 0; i < 4; i++) {
+		if (aux & (1 << i))
+			mask |= 0xffU << (i * 8);
+	}
+
+	return mask;
+}
+
+
+static void rt_forget_all(rt_trace_t *rt) {
+	for (int i = 0; i < rt->nregs; i++)
+		rt->regs[i].known = 0;
+}
+
+
+// PHY registers such as 0x14 on page 0xa43 are indirect data ports, so a
+// write to a page makes every other register of that page unknown
+static void rt_forget_page(rt_trace_t *rt, int reg) {
+	rt_reg_t *w = &rt->regs[reg];
+
+	for (int i = 0; i < rt->nregs; i++) {
+		rt_reg_t *r = &rt->regs[i];
+
+		if (i != reg && r->space == w->space && r->page == w->page)
+			r->known = 0;
+	}
+}
+
+
+static void rt_account(rt_trace_t *rt, int phase, int space, char op,
+		       unsigned int addr, unsigned int val, unsigned int aux,
+		       rt_access_t *prev) {
+	int is_phy = !strcmp(RtSpaces[space], "phy");
+	rt_stats_t *st = &rt->stats[phase][space];
+	unsigned int mask = rt_access_mask(space, op, aux);
+	int reg = rt_reg_index(rt, space, is_phy ? aux : 0, addr);
+	int same_reg = (reg >= 0 && prev->reg == reg);
+	rt_reg_t *r;
+
+	if (reg < 0)
+		return;
+	r = &rt->regs[reg];
+	r->phase = phase;
+
+	if (op == 'R') {
+		st->reads++;
+		if (same_reg && prev->op == 'W')
+			st->coalescible++;
+		r->val = val;
+		r->known = 0xffffffff;
+	} else {
+		st->writes++;
+		// rewriting a PHY data port advances it, so it is never redundant
+		if (same_reg && prev->op == 'W' && (is_phy || ((prev->val ^ val) & mask))) {
+			st->back2back++;
+		} else if ((r->known & mask) == mask && !((r->val ^ val) & mask)) {
+			st->redundant++;
+			r->redundant++;
+			if (same_reg && prev->op == 'R')
+				st->noop_rmw++;
+		}
+		r->val = (r->val & ~mask) | (val & mask);
+		r->known |= mask;
+		if (is_phy)
+			rt_forget_page(rt, reg);
+	}
+
+	prev->reg = reg;
+	prev->op = op;
+	prev->val = val;
+}
+
+
+static int rt_parse(FILE *fp, rt_trace_t *rt) {
+	char line[128], phase[RT_NAME_LEN], space[RT_NAME_LEN];
+	unsigned int addr, val, aux;
+	rt_access_t prev = { -1, 0, 0 };
+	char op;
+
+	if (!fgets(line, sizeof(line), fp) || sscanf(line, "chip %63s", rt->chip) != 1)
+		return -1;
+	if (!fgets(line, sizeof(line), fp) ||
+	    sscanf(line, "recorded %u lost %u", &rt->recorded, &rt->lost) != 2)
+		return -1;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%15s %15s %c %x %x %x", phase, space, &op, &addr, &val, &aux) != 6)
+			continue;
+
+		int ph = rt_phase_index(rt, phase);
+		if (ph < 0)
+			continue;
+
+		if (op == 'B') {
+			rt_forget_all(rt);
+			prev.reg = -1;
+			continue;
+		}
+
+		int sp = rt_space_index(space);
+		if (sp >= 0)
+			rt_account(rt, ph, sp, op, addr, val, aux, &prev);
+	}
+
+	return 0;
+}
+
+
+static int rt_cmp_redundant(const void *a, const void *b) {
+	const rt_reg_t *ra = a, *rb = b;
+
+	return (int)rb->redundant - (int)ra->redundant;
+}
+
+
+static void rt_print_report(FILE *fp, rt_trace_t *rt) {
+	fprintf(fp, "\nRegister trace of %s: %u accesses recorded, %u lost\n",
+		rt->chip, rt->recorded, rt->lost);
+	fprintf(fp, "\n%-12s %-8s %8s %8s %10s %9s %12s %10s\n", "phase", "space", "reads",
+		"writes", "redundant", "noop-rmw", "coalescible", "back2back");
+
+	for (int ph = 0; ph < rt->nphases; ph++) {
+		for (int sp = 0; sp < RT_MAX_SPACES; sp++) {
+			rt_stats_t *st = &rt->stats[ph][sp];
+
+			if (!st->reads && !st->writes)
+				continue;
+			fprintf(fp, "%-12s %-8s %8u %8u %10u %9u %12u %10u\n", rt->phases[ph],
+				RtSpaces[sp], st->reads, st->writes, st->redundant,
+				st->noop_rmw, st->coalescible, st->back2back);
+		}
+	}
+
+	qsort(rt->regs, rt->nregs, sizeof(rt_reg_t), rt_cmp_redundant);
+
+	fprintf(fp, "\nMost redundant registers:\n");
+	for (int i = 0; i < rt->nregs && i < RT_TOP_REGS && rt->regs[i].redundant; i++) {
+		rt_reg_t *r = &rt->regs[i];
+
+		if (!strcmp(RtSpaces[r->space], "phy"))
+			fprintf(fp, "  %-12s phy     page 0x%04x reg 0x%02x: %u\n",
+				rt->phases[r->phase], r->page, r->addr, r->redundant);
+		else
+			fprintf(fp, "  %-12s %-8s 0x%04x: %u\n", rt->phases[r->phase],
+				RtSpaces[r->space], r->addr, r->redundant);
+	}
+
+	fprintf(fp, "\nNote: status and self-clearing registers show up as redundant too,\n"
+		"back-to-back writes may be intended pulses or data port streams.\n");
+}
+
+
+void cmd_analyze_regtrace(const char dev_addr[], FILE *fp) {
+	char file_name[128];
+	rt_trace_t *rt;
+	FILE *trace;
+
+	snprintf(file_name, sizeof(file_name), "%s%s/regtrace", RT_DEBUGFS_DIR, dev_addr);
+	trace = fopen(file_name, "r");
+	if (!trace) {
+		perror("Error opening register trace (driver built with R8169_REGTRACE=1?)");
+		return;
+	}
+
+	rt = calloc(1, sizeof(rt_trace_t));
+	if (!rt) {
+		perror("Memory allocation failed");
+		fclose(trace);
+		return;
+	}
+
+	if (rt_parse(trace, rt))
+		fprintf(fp, "ERROR: %s is not a register trace!\n", file_name);
+	else
+		rt_print_report(fp, rt);
+
+	free(rt);
+	fclose(trace);
+}
@@ -0,0 +1,8 @@
+#ifndef PCI_REGTRACE_H
+#define PCI_REGTRACE_H
+
+#include <stdio.h>
+
+void cmd_analyze_regtrace(const char dev_addr[], FILE *fp);
+
+#endif
@@ -5,6 +5,7 @@
 // Local file includes
 #include "pci-tool-menu.h"
 #include "pci-commands.h"
+#include "pci-regtrace.h"
 
 // Macros
 #define PDEV_ADDR_LEN	(32)
@@ -67,6 +68,9 @@ void handle_cmd_menu(int cmd) {
 			cmd_get_config_header(PCIeDevAddr, &pci_config);
 			cmd_print_extended_caps(PCIeDevAddr, stdout, &pci_config, PRNT_COL);
 			break;
+		case MENU_ANALYZE_REGTRACE:
+			cmd_analyze_regtrace(PCIeDevAddr, stdout);
+			break;
 		default:
 			printf("\nThe command selected (%d) is not supported yet!\n", cmd);
 			break;